@@ -0,0 +1,825 @@
+// Benchmark suite for the resize pipeline. Generates a deterministic synthetic corpus in memory
+// (photo-like gradients and noise, flat graphics, alpha PNGs) and measures:
+//   stage: decode / resize / encode per corpus image on one thread (median of --iterations)
+//   e2e:   ResizeImageBuffer over the whole corpus at each --threads count
+//   quality: resize time and PSNR of every --filter x --colorspace combination and of
+//            --prefilter auto against the default single-pass stbir result, for images
+//            reduced at least 4x
+//   engine:  --resize-engine fixed against stb in both colour spaces, resize time and the
+//            largest per-channel difference, for every image that is resized
+//   planar:  JPEG to JPEG with --colorspace linear through YCbCr planes (--jpeg-planar auto)
+//            against the RGB pipeline, decode + resize + encode time and PSNR of the outputs
+//   layout:  ResizePixelBuffer on interleaved RGB against the same pixels as three planes, per
+//            engine, plus the cost of converting between the layouts
+//
+//   bench_imagecompress [--max-mp 12] [--iterations 5] [--threads 1,2,4,8] [--width 256] [--quality 80]
+//                       [--rounds N] [--csv results.csv] [--json results.json] [--write-corpus dir] [--seed 1]
+//
+// --max-mp 100 adds the 100 MP images. --write-corpus saves the encoded corpus so the main
+// binary can be run on exactly the same files.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "stb_image.h"
+#include "stb_image_write.h"
+#include "file_helpers.h"
+#include "image_processor.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+enum CorpusKind
+{
+    KIND_PHOTO,   // smooth gradients, soft blobs and sensor-like noise, stored as JPEG
+    KIND_GRAPHIC, // flat colour areas and hard edges, stored as PNG
+    KIND_ALPHA    // RGBA with a varying alpha mask, stored as PNG
+};
+
+static const char *kind_name(CorpusKind kind)
+{
+    switch (kind)
+    {
+    case KIND_PHOTO:
+        return "photo";
+    case KIND_GRAPHIC:
+        return "graphic";
+    default:
+        return "alpha";
+    }
+}
+
+struct CorpusImage
+{
+    string name;
+    CorpusKind kind;
+    int width;
+    int height;
+    string extension;
+    std::vector<unsigned char> encoded;
+
+    double megapixels() const { return (double)width * height / 1e6; }
+};
+
+// xorshift64*, the corpus must be identical on every machine and every run
+struct Rng
+{
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint32_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return (uint32_t)((state * 0x2545F4914F6CDD1Dull) >> 32);
+    }
+
+    int range(int lo, int hi) { return lo + (int)(next() % (uint32_t)(hi - lo + 1)); }
+};
+
+static unsigned char clamp_byte(int value)
+{
+    return (unsigned char)std::min(255, std::max(0, value));
+}
+
+static std::vector<unsigned char> make_photo(int w, int h, Rng &rng)
+{
+    struct Blob
+    {
+        float x, y, radius;
+        int r, g, b;
+    };
+    std::vector<Blob> blobs(6);
+    for (Blob &blob : blobs)
+        blob = {(float)rng.range(0, w), (float)rng.range(0, h), (float)rng.range(w / 8 + 1, w / 2 + 1),
+                rng.range(-80, 80), rng.range(-80, 80), rng.range(-80, 80)};
+
+    std::vector<unsigned char> pixels((size_t)w * h * 3);
+    for (int y = 0; y < h; ++y)
+    {
+        unsigned char *row = pixels.data() + (size_t)y * w * 3;
+        for (int x = 0; x < w; ++x)
+        {
+            int r = 60 + 120 * x / w, g = 90 + 100 * y / h, b = 140 - 60 * (x + y) / (w + h);
+            for (const Blob &blob : blobs)
+            {
+                const float dx = x - blob.x, dy = y - blob.y;
+                const float falloff = std::max(0.0f, 1.0f - (dx * dx + dy * dy) / (blob.radius * blob.radius));
+                r += (int)(blob.r * falloff);
+                g += (int)(blob.g * falloff);
+                b += (int)(blob.b * falloff);
+            }
+            const int noise = (int)(rng.next() % 17) - 8;
+            row[x * 3 + 0] = clamp_byte(r + noise);
+            row[x * 3 + 1] = clamp_byte(g + noise);
+            row[x * 3 + 2] = clamp_byte(b + noise);
+        }
+    }
+    return pixels;
+}
+
+static std::vector<unsigned char> make_graphic(int w, int h, int channels, Rng &rng)
+{
+    std::vector<unsigned char> pixels((size_t)w * h * channels);
+    const unsigned char background[3] = {(unsigned char)rng.range(200, 255), (unsigned char)rng.range(200, 255),
+                                         (unsigned char)rng.range(200, 255)};
+    for (size_t i = 0; i < (size_t)w * h; ++i)
+        for (int c = 0; c < 3; ++c)
+            pixels[i * channels + c] = background[c];
+
+    // overlapping flat rectangles plus thin stripes, like UI screenshots and logos
+    for (int n = 0; n < 24; ++n)
+    {
+        const int x0 = rng.range(0, w - 1), y0 = rng.range(0, h - 1);
+        const int x1 = std::min(w, x0 + rng.range(1, w / 3 + 1)), y1 = std::min(h, y0 + rng.range(1, h / 3 + 1));
+        const unsigned char colour[3] = {(unsigned char)rng.next(), (unsigned char)rng.next(), (unsigned char)rng.next()};
+        const bool striped = (n % 4) == 0;
+        for (int y = y0; y < y1; ++y)
+        {
+            if (striped && (y / 2) % 2)
+                continue;
+            for (int x = x0; x < x1; ++x)
+                for (int c = 0; c < 3; ++c)
+                    pixels[((size_t)y * w + x) * channels + c] = colour[c];
+        }
+    }
+
+    if (channels == 4)
+    {
+        // radial alpha with a fully transparent border and an opaque centre
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+            {
+                const float dx = (x - w / 2.0f) / (w / 2.0f), dy = (y - h / 2.0f) / (h / 2.0f);
+                pixels[((size_t)y * w + x) * 4 + 3] = clamp_byte((int)(255 * (1.3f - std::sqrt(dx * dx + dy * dy))));
+            }
+    }
+    return pixels;
+}
+
+static void append_to_vector(void *context, void *data, int size)
+{
+    auto *bytes = static_cast<std::vector<unsigned char> *>(context);
+    bytes->insert(bytes->end(), (unsigned char *)data, (unsigned char *)data + size);
+}
+
+static std::vector<CorpusImage> generate_corpus(double max_mp, uint64_t seed)
+{
+    static const int sizes[][2] = {{64, 64}, {320, 240}, {1024, 768}, {1920, 1080}, {4000, 3000}, {10000, 10000}};
+    static const CorpusKind kinds[] = {KIND_PHOTO, KIND_GRAPHIC, KIND_ALPHA};
+
+    std::vector<CorpusImage> corpus;
+    for (const auto &size : sizes)
+    {
+        if ((double)size[0] * size[1] / 1e6 > max_mp)
+            continue;
+        for (CorpusKind kind : kinds)
+        {
+            Rng rng(seed ^ ((uint64_t)size[0] << 32) ^ ((uint64_t)size[1] << 8) ^ kind);
+            CorpusImage image;
+            image.kind = kind;
+            image.width = size[0];
+            image.height = size[1];
+            image.extension = kind == KIND_PHOTO ? ".jpg" : ".png";
+            image.name = string(kind_name(kind)) + "_" + std::to_string(size[0]) + "x" + std::to_string(size[1]) + image.extension;
+
+            const int channels = kind == KIND_ALPHA ? 4 : 3;
+            const std::vector<unsigned char> pixels =
+                kind == KIND_PHOTO ? make_photo(size[0], size[1], rng) : make_graphic(size[0], size[1], channels, rng);
+
+            if (kind == KIND_PHOTO)
+                stbi_write_jpg_to_func(append_to_vector, &image.encoded, size[0], size[1], channels, pixels.data(), 90);
+            else
+                stbi_write_png_to_func(append_to_vector, &image.encoded, size[0], size[1], channels, pixels.data(), size[0] * channels);
+
+            cout << "  generated " << image.name << " (" << image.encoded.size() / 1024 << " KB)" << endl;
+            corpus.push_back(std::move(image));
+        }
+    }
+    return corpus;
+}
+
+struct BenchRow
+{
+    string bench;   // "stage" or "e2e"
+    string image;   // corpus image, "corpus" for e2e
+    string stage;   // decode / resize / encode / total
+    unsigned int threads = 1;
+    double megapixels = 0;
+    double seconds = 0; // median per image for stage rows, wall time for e2e rows
+    double images_per_s = 0;
+    double mp_per_s = 0;
+    double psnr = 0; // quality rows: dB against the reference variant, 0 for the reference itself
+    int max_diff = 0; // engine / layout rows: largest per-channel difference to the reference output
+    string note;      // last console column: "ref", the PSNR or max diff against it, empty if none
+};
+
+static BenchRow make_row(const string &bench, const string &image, const string &stage, double megapixels, double seconds)
+{
+    BenchRow row;
+    row.bench = bench;
+    row.image = image;
+    row.stage = stage;
+    row.megapixels = megapixels;
+    row.seconds = seconds;
+    row.images_per_s = seconds > 0 ? 1.0 / seconds : 0;
+    row.mp_per_s = seconds > 0 ? megapixels / seconds : 0;
+    return row;
+}
+
+static void print_header(const char *stage, const char *ms, const char *note, int stage_width)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-24s %-*s %10s %10s", "image", stage_width, stage, ms, "MP/s");
+    cout << line;
+    if (note != nullptr)
+    {
+        std::snprintf(line, sizeof(line), " %9s", note);
+        cout << line;
+    }
+    cout << endl;
+}
+
+// Prints the rows a section added from first on, with the note column if the header has one
+static void print_rows(const std::vector<BenchRow> &rows, size_t first, int stage_width, bool note)
+{
+    char line[256];
+    for (size_t i = first; i < rows.size(); ++i)
+    {
+        std::snprintf(line, sizeof(line), "%-24s %-*s %10.3f %10.1f", rows[i].image.c_str(), stage_width,
+                      rows[i].stage.c_str(), rows[i].seconds * 1e3, rows[i].mp_per_s);
+        cout << line;
+        if (note)
+        {
+            std::snprintf(line, sizeof(line), " %9s", rows[i].note.c_str());
+            cout << line;
+        }
+        cout << endl;
+    }
+}
+
+static double median(std::vector<double> values)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Runs ResizeImageBuffer on one image and splits the time by stage using the result breakdown
+static void bench_stages(const CorpusImage &image, const ResizeOptions &options, int iterations, std::vector<BenchRow> &rows)
+{
+    static const Stage stages[] = {STAGE_DECODE, STAGE_RESIZE, STAGE_ENCODE};
+    std::vector<double> samples[STAGE_COUNT];
+    std::vector<double> totals;
+    std::vector<unsigned char> output;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        ResizeResult result;
+        const auto start = std::chrono::steady_clock::now();
+        if (!ResizeImageBuffer(image.encoded.data(), image.encoded.size(), image.extension, options, output, image.name, &result))
+            return;
+        totals.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        for (Stage stage : stages)
+            samples[stage].push_back(result.stage_ns[stage] / 1e9);
+    }
+
+    for (Stage stage : stages)
+        rows.push_back(make_row("stage", image.name, StageName(stage), image.megapixels(), median(samples[stage])));
+    rows.push_back(make_row("stage", image.name, "total", image.megapixels(), median(totals)));
+}
+
+// One resampling setup compared by bench_quality
+struct QualityVariant
+{
+    string name;
+    ResizeOptions options;
+};
+
+// Resizes into a PNG, which is lossless, so the comparison sees only the resampling. Returns the
+// decoded output pixels and the median resize stage time.
+static bool resize_for_quality(const CorpusImage &image, const ResizeOptions &options, int iterations,
+                               std::vector<unsigned char> &pixels, double &resize_seconds)
+{
+    std::vector<unsigned char> output;
+    std::vector<double> samples;
+    for (int i = 0; i < iterations; ++i)
+    {
+        ResizeResult result;
+        if (!ResizeImageBuffer(image.encoded.data(), image.encoded.size(), ".png", options, output, image.name, &result))
+            return false;
+        samples.push_back(result.stage_ns[STAGE_RESIZE] / 1e9);
+    }
+    resize_seconds = median(samples);
+
+    int width, height, channels;
+    unsigned char *decoded = stbi_load_from_memory(output.data(), (int)output.size(), &width, &height, &channels, 0);
+    if (decoded == nullptr)
+        return false;
+    pixels.assign(decoded, decoded + (size_t)width * height * channels);
+    stbi_image_free(decoded);
+    return true;
+}
+
+static double psnr(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b)
+{
+    if (a.size() != b.size() || a.empty())
+        return 0;
+    double squared = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        const double diff = (double)a[i] - b[i];
+        squared += diff * diff;
+    }
+    const double mse = squared / a.size();
+    return mse == 0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+static string format_psnr(double db)
+{
+    char text[16];
+    std::snprintf(text, sizeof(text), "%.2f", db);
+    return text;
+}
+
+// Times the resize stage of every variant on one image and scores it against the first variant
+static void bench_quality(const CorpusImage &image, const std::vector<QualityVariant> &variants, int iterations,
+                          std::vector<BenchRow> &rows)
+{
+    std::vector<unsigned char> reference;
+    for (size_t v = 0; v < variants.size(); ++v)
+    {
+        std::vector<unsigned char> pixels;
+        double seconds = 0;
+        if (!resize_for_quality(image, variants[v].options, iterations, pixels, seconds))
+            return;
+
+        BenchRow row = make_row("quality", image.name, variants[v].name, image.megapixels(), seconds);
+        if (v == 0)
+        {
+            row.note = "ref";
+            reference = std::move(pixels);
+        }
+        else
+        {
+            row.psnr = psnr(reference, pixels);
+            row.note = format_psnr(row.psnr);
+        }
+        rows.push_back(row);
+    }
+}
+
+static int max_difference(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b)
+{
+    if (a.size() != b.size())
+        return 255;
+    int largest = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+        largest = std::max(largest, std::abs((int)a[i] - (int)b[i]));
+    return largest;
+}
+
+// Times stb and the fixed-point engine in each colour space on one image and compares their pixels
+static void bench_engines(const CorpusImage &image, const ResizeOptions &options, int iterations, std::vector<BenchRow> &rows)
+{
+    for (bool srgb : {true, false})
+    {
+        std::vector<unsigned char> reference;
+        for (ResizeEngine engine : {ENGINE_STB, ENGINE_FIXED})
+        {
+            ResizeOptions variant = options;
+            variant.prefilter = false;
+            variant.srgb = srgb;
+            variant.engine = engine;
+            std::vector<unsigned char> pixels;
+            double seconds = 0;
+            if (!resize_for_quality(image, variant, iterations, pixels, seconds))
+                return;
+
+            const string name = string(engine == ENGINE_FIXED ? "fixed" : "stb") + (srgb ? " srgb" : " linear");
+            BenchRow row = make_row("engine", image.name, name, image.megapixels(), seconds);
+            if (engine == ENGINE_STB)
+            {
+                row.note = "ref";
+                reference = std::move(pixels);
+            }
+            else
+            {
+                row.max_diff = max_difference(reference, pixels);
+                row.note = std::to_string(row.max_diff);
+            }
+            rows.push_back(row);
+        }
+    }
+}
+
+// JPEG to JPEG in linear mode with and without --jpeg-planar, the RGB pipeline is the reference
+static void bench_planar(const CorpusImage &image, const ResizeOptions &options, int iterations, std::vector<BenchRow> &rows)
+{
+    static const Stage stages[] = {STAGE_DECODE, STAGE_RESIZE, STAGE_ENCODE};
+    std::vector<unsigned char> reference;
+    for (bool planar : {false, true})
+    {
+        ResizeOptions variant = options;
+        variant.srgb = false;
+        variant.planar_jpeg = planar;
+        std::vector<unsigned char> output;
+        std::vector<double> totals;
+        for (int i = 0; i < iterations; ++i)
+        {
+            ResizeResult result;
+            if (!ResizeImageBuffer(image.encoded.data(), image.encoded.size(), ".jpg", variant, output, image.name, &result))
+                return;
+            double seconds = 0;
+            for (Stage stage : stages)
+                seconds += result.stage_ns[stage] / 1e9;
+            totals.push_back(seconds);
+        }
+
+        int width, height, channels;
+        unsigned char *decoded = stbi_load_from_memory(output.data(), (int)output.size(), &width, &height, &channels, 3);
+        if (decoded == nullptr)
+            return;
+        std::vector<unsigned char> pixels(decoded, decoded + (size_t)width * height * 3);
+        stbi_image_free(decoded);
+
+        BenchRow row = make_row("planar", image.name, planar ? "planar" : "rgb", image.megapixels(), median(totals));
+        if (planar)
+        {
+            row.psnr = psnr(reference, pixels);
+            row.note = format_psnr(row.psnr);
+        }
+        else
+        {
+            row.note = "ref";
+            reference = std::move(pixels);
+        }
+        rows.push_back(row);
+    }
+}
+
+// Resize kernels on interleaved RGB against one plane per channel, single pass. The planar rows
+// exclude the layout conversion, which gets its own row (split before plus merge after).
+static void bench_layouts(const CorpusImage &image, const ResizeOptions &options, int iterations, std::vector<BenchRow> &rows)
+{
+    int width, height, channels;
+    unsigned char *decoded = stbi_load_from_memory(image.encoded.data(), (int)image.encoded.size(), &width, &height, &channels, 3);
+    if (decoded == nullptr)
+        return;
+    PixelBuffer interleaved = MakePixelBuffer(PIXELS_INTERLEAVED, width, height, 3);
+    interleaved.data = decoded;
+    int output_width, output_height;
+    ComputeOutputSize(width, height, options, output_width, output_height);
+
+    std::vector<double> convert;
+    PixelBuffer planar;
+    for (int i = 0; i < iterations; ++i)
+    {
+        FreePixels(planar);
+        const auto start = std::chrono::steady_clock::now();
+        planar = DeinterleavePixels(interleaved);
+        PixelBuffer merged = InterleavePixels(planar);
+        convert.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        FreePixels(merged);
+    }
+    if (planar.data != nullptr)
+    {
+        rows.push_back(make_row("layout", image.name, "(de)interleave", image.megapixels(), median(convert)));
+        for (ResizeEngine engine : {ENGINE_STB, ENGINE_FIXED})
+        {
+            ResizeOptions variant = options;
+            variant.prefilter = false;
+            variant.engine = engine;
+            std::vector<unsigned char> reference;
+            for (PixelLayout layout : {PIXELS_INTERLEAVED, PIXELS_PLANAR})
+            {
+                const PixelBuffer &input = layout == PIXELS_PLANAR ? planar : interleaved;
+                PixelBuffer output = MakePixelBuffer(layout, output_width, output_height, 3);
+                std::vector<double> samples;
+                for (int i = 0; i < iterations; ++i)
+                {
+                    FreePixels(output);
+                    const auto start = std::chrono::steady_clock::now();
+                    if (!ResizePixelBuffer(input, output, variant))
+                        break;
+                    samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                }
+                if (output.data == nullptr)
+                    continue;
+
+                PixelBuffer merged = layout == PIXELS_PLANAR ? InterleavePixels(output) : output;
+                std::vector<unsigned char> pixels(merged.data, merged.data + merged.total_bytes());
+                if (merged.data != output.data)
+                    FreePixels(merged);
+                FreePixels(output);
+
+                const string name = string(engine == ENGINE_FIXED ? "fixed" : "stb") + (layout == PIXELS_PLANAR ? " planar" : " interleaved");
+                BenchRow row = make_row("layout", image.name, name, image.megapixels(), median(samples));
+                if (layout == PIXELS_INTERLEAVED)
+                {
+                    row.note = "ref";
+                    reference = std::move(pixels);
+                }
+                else
+                {
+                    row.max_diff = max_difference(reference, pixels);
+                    row.note = std::to_string(row.max_diff);
+                }
+                rows.push_back(row);
+            }
+        }
+    }
+    FreePixels(planar);
+    stbi_image_free(decoded);
+}
+
+// Every thread pulls corpus images by index until `rounds` passes over the corpus are done
+static BenchRow bench_end_to_end(const std::vector<CorpusImage> &corpus, const ResizeOptions &options, unsigned int threads, int rounds)
+{
+    const size_t total = corpus.size() * rounds;
+    std::atomic<size_t> next{0};
+    double megapixels = 0;
+    for (const CorpusImage &image : corpus)
+        megapixels += image.megapixels() * rounds;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            std::vector<unsigned char> output;
+            for (size_t i = next++; i < total; i = next++)
+            {
+                const CorpusImage &image = corpus[i % corpus.size()];
+                ResizeImageBuffer(image.encoded.data(), image.encoded.size(), image.extension, options, output, image.name);
+            }
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+
+    BenchRow row;
+    row.bench = "e2e";
+    row.image = "corpus";
+    row.stage = "total";
+    row.threads = threads;
+    row.megapixels = megapixels;
+    row.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    row.images_per_s = total / row.seconds;
+    row.mp_per_s = megapixels / row.seconds;
+    return row;
+}
+
+static bool write_csv(const string &path, const std::vector<BenchRow> &rows)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+    std::fprintf(file, "bench,image,stage,threads,megapixels,seconds,images_per_s,mp_per_s,psnr,max_diff\n");
+    for (const BenchRow &row : rows)
+        std::fprintf(file, "%s,%s,%s,%u,%.4f,%.6f,%.3f,%.3f,%.2f,%d\n", row.bench.c_str(), row.image.c_str(), row.stage.c_str(),
+                     row.threads, row.megapixels, row.seconds, row.images_per_s, row.mp_per_s, row.psnr, row.max_diff);
+    return std::fclose(file) == 0;
+}
+
+static bool write_json(const string &path, const std::vector<BenchRow> &rows, const ResizeOptions &options)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+    std::fprintf(file, "{\"hardware_threads\":%u,\"width\":%d,\"quality\":%d,\"results\":[\n",
+                 std::thread::hardware_concurrency(), options.width, options.quality);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        const BenchRow &row = rows[i];
+        std::fprintf(file, "%s{\"bench\":\"%s\",\"image\":\"%s\",\"stage\":\"%s\",\"threads\":%u,\"megapixels\":%.4f,"
+                           "\"seconds\":%.6f,\"images_per_s\":%.3f,\"mp_per_s\":%.3f,\"psnr\":%.2f,\"max_diff\":%d}",
+                     i ? ",\n" : "", row.bench.c_str(), row.image.c_str(), row.stage.c_str(), row.threads,
+                     row.megapixels, row.seconds, row.images_per_s, row.mp_per_s, row.psnr, row.max_diff);
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+static std::vector<unsigned int> parse_thread_list(const string &text)
+{
+    std::vector<unsigned int> threads;
+    std::stringstream stream(text);
+    string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty() && std::stoi(item) > 0)
+            threads.push_back((unsigned int)std::stoi(item));
+    return threads;
+}
+
+int main(int argc, char *argv[])
+{
+    double max_mp = 12;
+    int iterations = 5;
+    int rounds = 0;
+    uint64_t seed = 1;
+    string csv_path;
+    string json_path;
+    string corpus_dir;
+    ResizeOptions options;
+    options.width = 256;
+    options.quality = 80;
+
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int t = 1; t <= std::max(1u, std::thread::hardware_concurrency()); t *= 2)
+        thread_counts.push_back(t);
+    if (thread_counts.back() != std::thread::hardware_concurrency() && std::thread::hardware_concurrency() > 0)
+        thread_counts.push_back(std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            cout << "Error: " << arg << " needs a value (see the top of bench/bench_imagecompress.cpp)" << endl;
+            return 1;
+        }
+        if (arg == "--max-mp")
+            max_mp = std::stod(argv[++i]);
+        else if (arg == "--iterations")
+            iterations = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--rounds")
+            rounds = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--threads")
+            thread_counts = parse_thread_list(argv[++i]);
+        else if (arg == "--width")
+            options.width = std::stoi(argv[++i]);
+        else if (arg == "--quality")
+            options.quality = std::stoi(argv[++i]);
+        else if (arg == "--seed")
+            seed = std::stoull(argv[++i]);
+        else if (arg == "--csv")
+            csv_path = argv[++i];
+        else if (arg == "--json")
+            json_path = argv[++i];
+        else if (arg == "--write-corpus")
+            corpus_dir = argv[++i];
+        else
+        {
+            cout << "Error: unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    cout << "Generating synthetic corpus (up to " << max_mp << " MP, seed " << seed << ") ..." << endl;
+    const std::vector<CorpusImage> corpus = generate_corpus(max_mp, seed);
+    if (corpus.empty())
+    {
+        cout << "Error: --max-mp " << max_mp << " leaves no images in the corpus" << endl;
+        return 1;
+    }
+
+    if (!corpus_dir.empty())
+    {
+        std::filesystem::create_directories(corpus_dir);
+        for (const CorpusImage &image : corpus)
+        {
+            const string path = (std::filesystem::path(corpus_dir) / image.name).string();
+            if (!WriteFileBytes(path, image.encoded.data(), image.encoded.size()))
+            {
+                cout << "Error: could not write " << path << endl;
+                return 1;
+            }
+        }
+        cout << "Corpus written to " << corpus_dir << endl;
+    }
+
+    std::vector<BenchRow> rows;
+    char line[256];
+
+    cout << endl << "Per-stage, 1 thread, median of " << iterations << " runs" << endl;
+    print_header("stage", "ms", nullptr, 8);
+    for (const CorpusImage &image : corpus)
+    {
+        const size_t first = rows.size();
+        bench_stages(image, options, iterations, rows);
+        print_rows(rows, first, 8, false);
+    }
+
+    // the reference is the plain single-pass stbir resize, every other variant is scored against it
+    std::vector<QualityVariant> variants;
+    for (bool srgb : {true, false})
+    {
+        for (int filter = FILTER_DEFAULT; filter <= FILTER_POINT; ++filter)
+        {
+            QualityVariant variant{string(ResizeFilterName((ResizeFilter)filter)) + (srgb ? " srgb" : " linear"), options};
+            variant.options.prefilter = false;
+            variant.options.filter = (ResizeFilter)filter;
+            variant.options.srgb = srgb;
+            variants.push_back(variant);
+        }
+    }
+    variants.push_back(QualityVariant{"prefilter auto", options});
+    variants.back().options.prefilter = true;
+    variants.back().options.filter = FILTER_DEFAULT;
+    variants.back().options.srgb = true;
+
+    cout << endl << "Resampling quality against the single-pass resize (images reduced 4x or more)" << endl;
+    print_header("variant", "resize ms", "PSNR dB", 16);
+    for (const CorpusImage &image : corpus)
+    {
+        int output_width, output_height;
+        ComputeOutputSize(image.width, image.height, options, output_width, output_height);
+        if (image.width < output_width * 4 || image.height < output_height * 4)
+            continue;
+
+        const size_t first = rows.size();
+        bench_quality(image, variants, iterations, rows);
+        print_rows(rows, first, 16, true);
+    }
+
+    cout << endl << "Resize engines, fixed point against stb (single pass)" << endl;
+    print_header("engine", "resize ms", "max diff", 16);
+    for (const CorpusImage &image : corpus)
+    {
+        int output_width, output_height;
+        ComputeOutputSize(image.width, image.height, options, output_width, output_height);
+        if (image.width == output_width && image.height == output_height)
+            continue;
+
+        const size_t first = rows.size();
+        bench_engines(image, options, iterations, rows);
+        print_rows(rows, first, 16, true);
+    }
+
+    cout << endl << "JPEG to JPEG, YCbCr planes against RGB (--colorspace linear)" << endl;
+    print_header("path", "total ms", "PSNR dB", 16);
+    for (const CorpusImage &image : corpus)
+    {
+        if (image.extension != ".jpg")
+            continue;
+
+        const size_t first = rows.size();
+        bench_planar(image, options, iterations, rows);
+        print_rows(rows, first, 16, true);
+    }
+
+    cout << endl << "Pixel layout, interleaved RGB against planes (single pass resize)" << endl;
+    print_header("variant", "ms", "max diff", 18);
+    for (const CorpusImage &image : corpus)
+    {
+        int output_width, output_height;
+        ComputeOutputSize(image.width, image.height, options, output_width, output_height);
+        if (image.kind == KIND_ALPHA || (image.width == output_width && image.height == output_height))
+            continue;
+
+        const size_t first = rows.size();
+        bench_layouts(image, options, iterations, rows);
+        print_rows(rows, first, 18, true);
+    }
+
+    // small corpora are repeated so every thread count gets a few seconds of work
+    if (rounds == 0)
+    {
+        double total_seconds = 0;
+        for (const BenchRow &row : rows)
+            if (row.stage == "total")
+                total_seconds += row.seconds;
+        rounds = std::max(1, (int)std::ceil(2.0 / std::max(total_seconds, 1e-3)));
+    }
+
+    cout << endl << "End-to-end over the corpus, " << rounds << " round(s)" << endl;
+    std::snprintf(line, sizeof(line), "%8s %10s %12s %10s %9s", "threads", "seconds", "images/s", "MP/s", "speedup");
+    cout << line << endl;
+    double baseline = 0;
+    for (unsigned int threads : thread_counts)
+    {
+        BenchRow row = bench_end_to_end(corpus, options, threads, rounds);
+        if (baseline == 0)
+            baseline = row.images_per_s; // speedup is relative to the first thread count
+        std::snprintf(line, sizeof(line), "%8u %10.3f %12.1f %10.1f %8.2fx", threads, row.seconds, row.images_per_s,
+                      row.mp_per_s, baseline > 0 ? row.images_per_s / baseline : 0.0);
+        cout << line << endl;
+        rows.push_back(row);
+    }
+
+    if (!csv_path.empty() && !write_csv(csv_path, rows))
+    {
+        cout << "Error: could not write " << csv_path << endl;
+        return 1;
+    }
+    if (!json_path.empty() && !write_json(json_path, rows, options))
+    {
+        cout << "Error: could not write " << json_path << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Load-test harness for ImageCompress --http. Drives the local server with a fixed number of
+// keep-alive connections and reports throughput and latency percentiles.
+//
+//   http_loadtest --port 8080 --path "/resize?src=a.jpg&w=256" [--path ...] [--connections 8] [--requests 2000]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_recorder.h"
+#include "net_helpers.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static int connect_local(int port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || ::connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    int nodelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return fd;
+}
+
+// Sends one GET and reads the whole response. Returns the status code, 0 on connection errors.
+static int do_request(int fd, SocketReader &reader, const string &path, size_t &body_bytes)
+{
+    const string request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+    if (!SendAll(fd, request.data(), request.size()))
+        return 0;
+
+    string line;
+    if (!reader.read_line(line) || line.size() < 12)
+        return 0;
+    const int status = std::atoi(line.c_str() + 9);
+
+    size_t content_length = 0;
+    while (reader.read_line(line) && !line.empty())
+    {
+        if (line.rfind("Content-Length:", 0) == 0)
+            content_length = std::stoull(line.substr(15));
+    }
+
+    std::vector<unsigned char> body;
+    if (!reader.read_exact(body, content_length))
+        return 0;
+    body_bytes = content_length;
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    int port = 8080;
+    unsigned int connections = 8;
+    unsigned int total_requests = 2000;
+    std::vector<string> paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc)
+            port = std::stoi(argv[++i]);
+        else if (arg == "--path" && i + 1 < argc)
+            paths.push_back(argv[++i]);
+        else if (arg == "--connections" && i + 1 < argc)
+            connections = (unsigned int)std::stoi(argv[++i]);
+        else if (arg == "--requests" && i + 1 < argc)
+            total_requests = (unsigned int)std::stoi(argv[++i]);
+        else
+        {
+            cout << "Usage: http_loadtest --port <port> --path <url path> [--path ...] [--connections N] [--requests N]" << endl;
+            return 1;
+        }
+    }
+    if (paths.empty() || connections == 0)
+    {
+        cout << "Error: at least one --path and one connection are required." << endl;
+        return 1;
+    }
+
+    LatencyRecorder latency(total_requests);
+    std::atomic<unsigned int> next_request{0};
+    std::atomic<unsigned long long> failures{0}, bytes_received{0};
+
+    auto client = [&]()
+    {
+        int fd = connect_local(port);
+        std::unique_ptr<SocketReader> reader = fd >= 0 ? std::make_unique<SocketReader>(fd) : nullptr;
+
+        while (true)
+        {
+            const unsigned int index = next_request.fetch_add(1);
+            if (index >= total_requests)
+                break;
+
+            if (fd < 0)
+            {
+                fd = connect_local(port);
+                reader = fd >= 0 ? std::make_unique<SocketReader>(fd) : nullptr;
+                if (fd < 0)
+                {
+                    failures++;
+                    continue;
+                }
+            }
+
+            size_t body_bytes = 0;
+            const auto start = std::chrono::steady_clock::now();
+            const int status = do_request(fd, *reader, paths[index % paths.size()], body_bytes);
+            latency.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+            if (status != 200)
+                failures++;
+            bytes_received += body_bytes;
+            if (status == 0)
+            {
+                // reconnect on the next request
+                reader.reset();
+                ::close(fd);
+                fd = -1;
+            }
+        }
+
+        if (fd >= 0)
+            ::close(fd);
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (unsigned int i = 0; i < connections; ++i)
+        clients.emplace_back(client);
+    for (std::thread &thread : clients)
+        thread.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const LatencyRecorder::Summary summary = latency.summary();
+    cout << "requests:     " << summary.count << " (" << failures.load() << " failed)" << endl;
+    cout << "connections:  " << connections << endl;
+    cout << "elapsed:      " << seconds << " s" << endl;
+    cout << "requests/sec: " << summary.count / seconds << endl;
+    cout << "MB/sec:       " << bytes_received.load() / seconds / (1024.0 * 1024.0) << endl;
+    cout << "latency ms:   p50=" << summary.p50 << " p90=" << summary.p90 << " p99=" << summary.p99 << " max=" << summary.max << endl;
+    return failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,70 @@
+#!/bin/bash
+# Two-phase PGO + LTO build trained on the synthetic benchmark corpus, then a throughput
+# comparison against the plain release build.
+#   ./build_linux_pgo.sh [max-mp]   (corpus size limit, default 12)
+set -e
+
+MAX_MP=${1:-12}
+CORPUS=build-linux-pgo-corpus
+PROFILES=$(pwd)/build-linux-pgo-profiles
+
+if ${CXX:-c++} --version | grep -qi clang; then
+    CLANG=1
+fi
+
+echo "--- Building plain Linux Release (baseline) ---"
+./build_linux_release.sh
+
+echo "--- Generating training corpus ---"
+rm -rf "$CORPUS" "$PROFILES"
+./build-linux-release/bench_imagecompress --max-mp "$MAX_MP" --iterations 1 --threads 1 --write-corpus "$CORPUS" > /dev/null
+
+echo "--- Phase 1: instrumented build ---"
+cmake -B build-linux-pgo-generate \
+      -D CMAKE_BUILD_TYPE=Release \
+      -D IMAGECOMPRESS_LTO=ON \
+      -D IMAGECOMPRESS_PGO=generate \
+      -D IMAGECOMPRESS_PGO_DIR="$PROFILES" \
+      -S .
+cmake --build build-linux-pgo-generate --target ImageCompress
+
+echo "--- Training on $CORPUS ---"
+# the usual shapes of work: fixed-width thumbnails, a percentage scale, low and high quality
+train() {
+    rm -rf build-linux-pgo-generate/train-out
+    ./build-linux-pgo-generate/ImageCompress --imgdir "$CORPUS" --outdir build-linux-pgo-generate/train-out "$@" > /dev/null
+}
+train --width 256 --quality 80
+train --size-factor 50 --quality 90
+train --height 1080 --quality 60
+if [ -n "$CLANG" ]; then
+    llvm-profdata merge -output="$PROFILES/default.profdata" "$PROFILES"/*.profraw
+fi
+
+echo "--- Phase 2: optimised build ---"
+cmake -B build-linux-pgo \
+      -D CMAKE_BUILD_TYPE=Release \
+      -D IMAGECOMPRESS_LTO=ON \
+      -D IMAGECOMPRESS_PGO=use \
+      -D IMAGECOMPRESS_PGO_DIR="$PROFILES" \
+      -S .
+cmake --build build-linux-pgo --target ImageCompress
+
+echo "--- Comparing throughput (single thread, best of 3) ---"
+throughput() {
+    local best=0
+    for run in 1 2 3; do
+        rm -rf "$1-bench-out"
+        local rate
+        rate=$("$1/ImageCompress" --imgdir "$CORPUS" --outdir "$1-bench-out" --width 256 --quality 80 --threads 1 --stats \
+               | sed -n 's/^images:.* \([0-9.]*\) images\/s$/\1/p')
+        best=$(echo "$rate $best" | awk '{ print ($1 > $2) ? $1 : $2 }')
+    done
+    rm -rf "$1-bench-out"
+    echo "$best"
+}
+BASE=$(throughput build-linux-release)
+PGO=$(throughput build-linux-pgo)
+echo "release:   $BASE images/s"
+echo "pgo + lto: $PGO images/s"
+echo "$BASE $PGO" | awk '{ printf "delta:     %+.1f%%\n", ($2 / $1 - 1) * 100 }'
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Allocation accounting for the stb decoders, resizer and encoders. image_processor.cpp routes
+// STBI_MALLOC, STBIR_MALLOC and STBIW_MALLOC (and their realloc/free) through these functions,
+// which keep a per-thread count of live bytes and its high-water mark. Every image is processed
+// start to finish on one thread, so the per-thread peak is the image's peak.
+
+void *AllocTrackedMalloc(size_t size);
+void *AllocTrackedRealloc(void *pointer, size_t size);
+void AllocTrackedFree(void *pointer);
+
+// Live stb heap bytes on this thread
+uint64_t AllocCurrentBytes();
+
+// Highest AllocCurrentBytes() since the last AllocResetPeak() on this thread
+uint64_t AllocPeakBytes();
+
+// Starts a new peak window at the current live size
+void AllocResetPeak();
+
+// High-water resident set size of the whole process, 0 where the platform doesn't report it
+uint64_t PeakRssBytes();
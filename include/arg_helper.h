@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <filesystem>
 
@@ -8,9 +10,9 @@ using std::string;
 namespace fs = std::filesystem;
 
 void print_help_msg();
+bool validate_resize_params(int _size, int _quality, int _width, int _height);
 bool validate_params(const std::string &_imgdir,
                      const std::string &_outdir,
-                     int _size,
-                     int _quality,
-                     int _width,
-                     int _height);
\ No newline at end of file
+                     const std::string &_input_tar,
+                     const std::string &_output_tar,
+                     const std::string &_output_pack);
\ No newline at end of file
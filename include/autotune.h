@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+#include "image_processor.h"
+
+// --autotune: short calibration on up to max_files images from imgdir. Picks the thread count
+// (fewest within 3% of the best), then for PNG outputs the fastest zlib level and row filter whose
+// output stays within 3% of the default size, and writes them with the --plan cost model to profile_path.
+int RunAutotune(const std::string &imgdir, const std::string &imgname, size_t max_files,
+                const ResizeOptions &options, const std::string &profile_path);
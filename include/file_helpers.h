@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Reads a whole file into memory. Returns false if the file can't be opened or read.
+bool ReadFileBytes(const std::string &filepath, std::vector<unsigned char> &bytes);
+
+// Writes (or overwrites) a file with the given bytes. Returns false on any I/O error.
+bool WriteFileBytes(const std::string &filepath, const unsigned char *data, size_t length);
+
+// Copies src to dest (overwriting), sharing extents where the filesystem allows: a reflink
+// (FICLONE) first, then copy_file_range, then a plain copy. Linux-only paths fall back silently.
+bool CloneFile(const std::string &src, const std::string &dest);
+
+// True for the extensions ImageCompress can decode and encode (.jpg, .jpeg, .png)
+bool IsSupportedImage(const std::string &filepath);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "image_processor.h"
+
+// --resize-engine fixed: a separable polyphase resizer for uint8 images that stays in integers.
+// Per-axis int16 coefficients (summing to 1 << 14) are built once per geometry and filter with the
+// same kernels, supports and clamped edges as stbir, pixels travel as 14-bit values (sRGB decoded
+// through a lookup table, or the stored values shifted up) in 16-bit intermediate rows, and both
+// passes use pmaddwd multiply-adds (SSE2, AVX2 when the CPU has it). Output matches stbir within
+// one level. Fastest on large reductions; enlargements run about as fast as stbir.
+//
+// Gray and RGB only: layouts with alpha need stbir's premultiplied path and stay on stbir. So does
+// FILTER_POINT, which stbir samples from one nearest pixel without sRGB conversion.
+bool FixedResizeSupports(int channels, ResizeFilter filter);
+
+// Resizes a tightly packed image. The result comes from AllocTrackedMalloc (free it with
+// AllocTrackedFree / STBIR_FREE), nullptr if the layout isn't supported or memory ran out.
+unsigned char *FixedResize(const unsigned char *input_pixels, int input_w, int input_h, int channels,
+                           int output_w, int output_h, ResizeFilter filter, bool srgb);
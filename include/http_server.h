@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "image_processor.h"
+
+// --http <port>: embedded HTTP/1.1 resize server bound to 127.0.0.1.
+//
+//   GET /resize?src=<path under --imgdir>&w=<px>&h=<px>&size=<pct>&q=<1-100>&format=jpg|png
+//   GET /stats
+//
+// Encoded results are kept in a byte-bounded LRU cache. On Linux cached bodies live in memfds
+// and hits are sent with sendfile(), so a hit never copies the image through user space.
+// Blocks until SIGINT/SIGTERM and returns the process exit code.
+int RunHttpServer(int port, const std::string &root_dir, unsigned int threads, size_t cache_bytes, const ResizeOptions &defaults);
@@ -1,8 +1,145 @@
+#pragma once
+
+#include <cstdint>
 #include <string>
+#include <vector>
+#include "pixel_buffer.h"
+#include "stats.h"
+
+class ResultCache;
+
+// --filter, the stbir resampling kernels (same order as stbir_filter)
+enum ResizeFilter
+{
+    FILTER_DEFAULT,  // stbir's choice: Mitchell when shrinking, Catmull-Rom when enlarging
+    FILTER_BOX,
+    FILTER_TRIANGLE,
+    FILTER_CUBIC,    // cubic B-spline, soft
+    FILTER_CATMULL,  // Catmull-Rom, sharp
+    FILTER_MITCHELL,
+    FILTER_POINT,
+};
+
+const char *ResizeFilterName(ResizeFilter filter);
+
+// Parses a --filter name ("default" included), false if unknown
+bool ParseResizeFilter(const std::string &name, ResizeFilter &filter);
+
+// --resize-engine
+enum ResizeEngine
+{
+    ENGINE_STB,   // stb_image_resize2, float pipeline, every layout
+    ENGINE_FIXED, // fixed_resize.h, int16 fixed point for gray and RGB (alpha layouts still use stb)
+};
+
+// Resize/encode settings shared by every input and output mode
+struct ResizeOptions
+{
+    int size = 100;   // --size-factor percentage
+    int quality = 100; // JPEG quality
+    int width = 0;    // --width, 0 = not set
+    int height = 0;   // --height, 0 = not set
+    bool no_upscale = false;   // --no-upscale, never make the output larger than the input
+    bool keep_smaller = false; // --keep-smaller, emit the source when the encoded output isn't smaller
+    bool detect_gray = false;  // --detect-gray, process visually gray RGB(A) sources as gray(+alpha)
+    bool fast_alpha = false;   // --fast-alpha, cheaper alpha weighting, colour under alpha 0 is not preserved
+    bool prefilter = true;     // --prefilter auto|off, 2x2 box pyramid ahead of stbir for big reductions
+    ResizeFilter filter = FILTER_DEFAULT; // --filter
+    bool srgb = true;          // --colorspace srgb|linear, false filters the stored values as they are
+    ResizeEngine engine = ENGINE_STB; // --resize-engine
+    bool planar_jpeg = true;   // --jpeg-planar auto|off, JPEG to JPEG resized as Y/Cb/Cr planes, no colour conversion
+};
+
+enum ResizeStatus
+{
+    RESIZE_OK,
+    RESIZE_READ_FAILED,
+    RESIZE_DECODE_FAILED,
+    RESIZE_RESIZE_FAILED,
+    RESIZE_ENCODE_FAILED,
+    RESIZE_WRITE_FAILED,
+    RESIZE_EXCEPTION,
+};
+
+const char *ResizeStatusName(ResizeStatus status);
+
+// What happened to one image, filled in stage by stage
+struct ResizeResult
+{
+    ResizeStatus status = RESIZE_OK;
+    std::string input_path;
+    std::string output_path;
+    int input_width = 0;
+    int input_height = 0;
+    int output_width = 0;
+    int output_height = 0;
+    int channels = 0; // channels the image was processed and encoded with
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t stage_ns[STAGE_COUNT] = {};
+    uint64_t peak_bytes[STAGE_COUNT] = {}; // live stb heap high-water during decode/resize/encode
+    bool cache_hit = false;                 // output came from --cache-dir, nothing was decoded
+    bool passthrough = false;               // output is the source file unchanged
+    bool upscale_avoided = false;           // --no-upscale kept the input size
+    bool kept_source = false;               // --keep-smaller chose the source over a larger encode
+
+    bool ok() const { return status == RESIZE_OK; }
+};
+
+// Output geometry for an input of the given size, the same rules ResizeImageBuffer applies.
+// Returns true when --no-upscale replaced a larger target with the input size.
+bool ComputeOutputSize(int input_width, int input_height, const ResizeOptions &options, int &output_width, int &output_height);
+
+// Replaces the geometry in options with a request's width, height or size percentage (0 = not
+// given), keeping the defaults when none is given. Like on the command line only one may be set;
+// false if more than one is.
+bool SetResizeGeometry(ResizeOptions &options, int width, int height, int size);
+
+// Process-wide PNG encoder settings: zlib level 1-9 (stb default 8) and filter 0-4, or -1 to let
+// the encoder pick the best filter per row (the default, and the slowest)
+void SetPngEncoderOptions(int compression_level, int filter);
+
+// Estimated IJG quality (1-100) of a JPEG from its luminance quantisation table, 0 if there is none
+int EstimateJpegQuality(const unsigned char *data, size_t length);
+
+// True when the source can be emitted as is: the output geometry equals the input, the data is
+// really in the extension's format, and re-encoding could not help (PNG is lossless; a JPEG only
+// if the requested quality is at least the source's). width/height/channels come from the header.
+bool CanPassThrough(const unsigned char *data, size_t length, const std::string &extension, const ResizeOptions &options,
+                    int &width, int &height, int &channels);
+
+// Every setting that affects the encoded output for this extension, in a canonical form
+// (options that don't apply are left out). Bump the version prefix when the pipeline changes.
+std::string ProcessingKey(const std::string &extension, const ResizeOptions &options);
+
+// Name (no directory) of the resized output for an input file, e.g. photo_50_80.jpg
+std::string OutputFileName(const std::string &filepath, const ResizeOptions &options);
+
+// Fills result and the thread's stats for an output taken from --cache-dir. width/height are the
+// source's as CanPassThrough reports them (0 if unknown); the output geometry follows from them.
+void RecordCacheHit(ResizeResult &result, const ResizeOptions &options, int width, int height, uint64_t bytes_in, uint64_t bytes_out);
+
+// The resize stage on its own. output's layout, channels and plane sizes are set by the caller and
+// must match input's layout and channels; its data is allocated here (FreePixels). Interleaved
+// images go through the --prefilter pyramid and the --resize-engine with alpha weighting; planar
+// ones are filtered plane by plane, so alpha is not weighted. False if the resize failed.
+bool ResizePixelBuffer(const PixelBuffer &input, PixelBuffer &output, const ResizeOptions &options);
+
+// Decodes an encoded JPEG/PNG from memory, resizes it and encodes the result into out_bytes.
+// The output format follows extension (".png", ".jpg", ".jpeg"). label is only used in error messages.
+// result, when given, receives status, geometry, sizes and decode/resize/encode timings.
+// check_passthrough false skips CanPassThrough for callers that already found it false.
+bool ResizeImageBuffer(const unsigned char *data,
+                       size_t length,
+                       const std::string &extension,
+                       const ResizeOptions &options,
+                       std::vector<unsigned char> &out_bytes,
+                       const std::string &label,
+                       ResizeResult *result = nullptr,
+                       bool check_passthrough = true);
 
-void ResizeImage(const std::string &filepath,
-                 const std::string &_outdir,
-                 int _size,
-                 int _quality,
-                 int _width,
-                 int _height);
\ No newline at end of file
+// cache, when given, is consulted before decoding and filled after encoding
+ResizeResult ResizeImage(const std::string &filepath,
+                         const std::string &_outdir,
+                         const ResizeOptions &options,
+                         ResultCache *cache = nullptr);
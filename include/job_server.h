@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include "image_processor.h"
+
+// --serve <socket>: long-running daemon that keeps a warm worker pool (threads, their malloc
+// arenas and resampler caches stay alive between jobs) and accepts jobs over a Unix domain socket.
+//
+// Protocol, one request line per job, values percent-encoded:
+//   RESIZE src=<path> [out=<file> | outdir=<dir>] [width=N] [height=N] [size=N] [quality=N] [format=jpg|png]
+//   RESIZE bytes=<N> [...same options...]\n<N bytes of encoded image>
+//   STATS
+//   PING
+//   QUIT
+// Responses:
+//   OK path=<file> bytes=N width=W height=H channels=C ms=T       (result written to out/outdir)
+//   OK bytes=N width=W height=H channels=C ms=T\n<N bytes>        (result returned inline)
+//   OK count=N p50_ms=.. p90_ms=.. p99_ms=.. max_ms=.. errors=N  (STATS)
+//   ERR <message>
+//
+// Blocks until SIGINT/SIGTERM and returns the process exit code.
+int RunJobServer(const std::string &socket_path, unsigned int threads, const ResizeOptions &defaults);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Thread-safe latency recorder for the long-running modes (--serve, --http, --watch).
+// Keeps the most recent `window` samples so percentiles follow the current load, plus
+// lifetime count and max.
+class LatencyRecorder
+{
+public:
+    explicit LatencyRecorder(size_t window = 10000) : window_(window == 0 ? 1 : window) {}
+
+    void record(double milliseconds)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (samples_.size() < window_)
+            samples_.push_back(milliseconds);
+        else
+            samples_[count_ % window_] = milliseconds;
+        ++count_;
+        max_ = std::max(max_, milliseconds);
+    }
+
+    struct Summary
+    {
+        uint64_t count = 0;
+        double p50 = 0, p90 = 0, p99 = 0, max = 0;
+    };
+
+    Summary summary() const
+    {
+        std::vector<double> sorted;
+        Summary result;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sorted = samples_;
+            result.count = count_;
+            result.max = max_;
+        }
+        if (sorted.empty())
+            return result;
+
+        std::sort(sorted.begin(), sorted.end());
+        auto at = [&sorted](double q) { return sorted[std::min(sorted.size() - 1, (size_t)(q * (sorted.size() - 1) + 0.5))]; };
+        result.p50 = at(0.50);
+        result.p90 = at(0.90);
+        result.p99 = at(0.99);
+        return result;
+    }
+
+    // "count=N p50_ms=.. p90_ms=.. p99_ms=.. max_ms=.."
+    std::string format() const
+    {
+        const Summary s = summary();
+        char text[160];
+        std::snprintf(text, sizeof(text), "count=%llu p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f",
+                      (unsigned long long)s.count, s.p50, s.p90, s.p99, s.max);
+        return text;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<double> samples_;
+    size_t window_;
+    uint64_t count_ = 0;
+    double max_ = 0;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// Small socket helpers shared by the --serve (Unix socket) and --http servers. POSIX only.
+
+// Writes the whole buffer, retrying on short writes. Never raises SIGPIPE.
+bool SendAll(int fd, const void *data, size_t length);
+
+// Buffered reads from a socket for line based protocols with binary payloads
+class SocketReader
+{
+public:
+    explicit SocketReader(int fd) : fd_(fd) {}
+
+    // Reads up to and excluding "\n" (a trailing "\r" is dropped too). False on EOF/error or
+    // if the line is longer than max_length.
+    bool read_line(std::string &line, size_t max_length = 64 * 1024);
+
+    // Reads exactly length bytes
+    bool read_exact(std::vector<unsigned char> &data, size_t length);
+
+private:
+    bool fill();
+
+    int fd_;
+    std::vector<char> buffer_ = std::vector<char>(64 * 1024);
+    size_t begin_ = 0;
+    size_t end_ = 0;
+};
+
+// Decodes %XX escapes (and '+' as space when plus_as_space is set)
+std::string PercentDecode(const std::string &value, bool plus_as_space = false);
+
+// Escapes ' ', '%', '&', '=' and control bytes as %XX so a value fits in one key=value token
+std::string PercentEncode(const std::string &value);
+
+// Splits "a=1 b=2" (separator ' ') or "a=1&b=2" (separator '&') into a map, values percent-decoded
+std::map<std::string, std::string> ParseKeyValues(const std::string &text, char separator);
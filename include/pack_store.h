@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Packed output: every encoded image is appended to one blob file (<pack>) and a sorted
+// index (<pack>.idx) maps name -> offset, length, dimensions and format for serving.
+//
+// Index layout (little-endian):
+//   PackIndexHeader
+//   PackIndexRecord[count]   sorted by name (byte-wise)
+//   name bytes               referenced by PackIndexRecord::name_offset
+
+enum PackFormat : uint8_t
+{
+    PACK_FORMAT_UNKNOWN = 0,
+    PACK_FORMAT_JPEG = 1,
+    PACK_FORMAT_PNG = 2,
+};
+
+struct PackIndexHeader
+{
+    char magic[8];          // "ICPACK1"
+    uint64_t count;
+    uint64_t names_offset;  // file offset of the name bytes
+};
+
+struct PackIndexRecord
+{
+    uint64_t offset;        // into the blob
+    uint64_t length;
+    uint64_t name_offset;   // into the name bytes
+    uint32_t name_length;
+    uint32_t width;
+    uint32_t height;
+    uint8_t channels;
+    uint8_t format;         // PackFormat
+    uint16_t reserved;
+};
+static_assert(sizeof(PackIndexRecord) == 40, "PackIndexRecord is part of the on-disk format");
+
+struct PackEntry
+{
+    std::string name;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t channels = 0;
+    uint8_t format = PACK_FORMAT_UNKNOWN;
+};
+
+PackFormat PackFormatFromName(const std::string &name);
+const char *PackFormatName(uint8_t format);
+
+// Appends encoded images from any number of worker threads. Each append reserves its byte
+// range with an atomic offset and writes it positionally, so workers never wait on each other
+// for the blob. finish() sorts the entries and writes the index.
+class PackWriter
+{
+public:
+    explicit PackWriter(const std::string &path);
+    ~PackWriter();
+
+    PackWriter(const PackWriter &) = delete;
+    PackWriter &operator=(const PackWriter &) = delete;
+
+    bool is_open() const;
+
+    bool append(const std::string &name, const unsigned char *data, size_t length, int width, int height, int channels);
+
+    bool finish();
+
+private:
+    std::string path_;
+#ifdef _WIN32
+    FILE *file_ = nullptr;
+    std::mutex file_mutex_;
+#else
+    int fd_ = -1;
+#endif
+    std::atomic<uint64_t> next_offset_{0};
+    std::mutex entries_mutex_;
+    std::vector<PackEntry> entries_;
+    bool finished_ = false;
+};
+
+// Read-only view of a pack. The index is memory mapped and looked up with a binary search.
+class PackReader
+{
+public:
+    explicit PackReader(const std::string &path);
+    ~PackReader();
+
+    PackReader(const PackReader &) = delete;
+    PackReader &operator=(const PackReader &) = delete;
+
+    bool is_open() const { return records_ != nullptr; }
+    uint64_t size() const { return count_; }
+
+    bool find(const std::string &name, PackEntry &entry) const;
+    bool read(const PackEntry &entry, std::vector<unsigned char> &data) const;
+
+private:
+    const unsigned char *index_ = nullptr;
+    size_t index_size_ = 0;
+    const PackIndexRecord *records_ = nullptr;
+    const char *names_ = nullptr;
+    uint64_t count_ = 0;
+#ifdef _WIN32
+    std::vector<unsigned char> index_copy_;
+    FILE *blob_ = nullptr;
+    mutable std::mutex blob_mutex_;
+#else
+    int blob_fd_ = -1;
+#endif
+};
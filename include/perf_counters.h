@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Optional hardware counters (--perf-counters) sampled around every StageTimer. Each thread opens
+// one perf_event_open group on first use and reads all counters with a single read(). Linux only;
+// everywhere else, and when the kernel refuses (perf_event_paranoid, containers, VMs without a
+// PMU), PerfCountersEnable() fails and the pipeline runs exactly as without the flag.
+
+enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+const char *PerfCounterName(PerfCounter counter);
+
+struct PerfSample
+{
+    uint64_t values[PERF_COUNTER_COUNT] = {};
+    uint64_t time_enabled = 0;
+    uint64_t time_running = 0;
+    bool valid = false;
+};
+
+extern bool g_perf_enabled;
+
+inline bool PerfCountersEnabled()
+{
+    return g_perf_enabled;
+}
+
+// Probes the counters on the calling thread. Must be called before any worker thread starts.
+// Returns false with a human-readable reason when they can't be used.
+bool PerfCountersEnable(std::string &reason);
+
+// True if the counter opened during the probe; some PMUs lack LLC or branch events
+bool PerfCounterAvailable(PerfCounter counter);
+
+// Reads this thread's counters, sample.valid is false if the thread's group couldn't be opened
+void PerfCountersRead(PerfSample &sample);
+
+// Adds end - start to totals, scaled up when the kernel multiplexed the group
+void PerfCountersAccumulate(const PerfSample &start, const PerfSample &end, uint64_t totals[PERF_COUNTER_COUNT]);
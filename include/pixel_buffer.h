@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+// How an image's bytes are arranged between the pipeline stages
+enum PixelLayout
+{
+    PIXELS_INTERLEAVED, // one plane with all channels per pixel, as stb_image decodes and the PNG encoder takes
+    PIXELS_PLANAR,      // one single-channel plane per channel, back to back, each with its own size
+};
+
+// Decoded, resized or about to be encoded pixels in one allocation (AllocTrackedMalloc, so it can
+// be released with stbi_image_free / STBIR_FREE / FreePixels alike). Planar planes may be smaller
+// than the first one, e.g. JPEG chroma at half size.
+struct PixelBuffer
+{
+    unsigned char *data = nullptr;
+    PixelLayout layout = PIXELS_INTERLEAVED;
+    int channels = 0;                  // channels per pixel, also the number of planes when planar
+    int width[4] = {}, height[4] = {}; // per plane, interleaved only uses [0]
+
+    int planes() const { return layout == PIXELS_PLANAR ? channels : 1; }
+    int plane_channels() const { return layout == PIXELS_PLANAR ? 1 : channels; }
+    size_t plane_bytes(int plane) const { return (size_t)width[plane] * height[plane] * plane_channels(); }
+    size_t total_bytes() const;
+    unsigned char *plane(int plane) const;
+};
+
+// A buffer description with every plane width x height, data not allocated yet
+PixelBuffer MakePixelBuffer(PixelLayout layout, int width, int height, int channels);
+
+// Allocates data for the layout, channels and plane sizes already set, false if out of memory
+bool AllocPixels(PixelBuffer &buffer);
+void FreePixels(PixelBuffer &buffer);
+
+// Layout conversions for buffers whose planes are all the same size. The result is a new
+// allocation, its data nullptr if out of memory.
+PixelBuffer DeinterleavePixels(const PixelBuffer &interleaved);
+PixelBuffer InterleavePixels(const PixelBuffer &planar);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "image_processor.h"
+#include "scaling_sweep.h"
+#include "tuning_profile.h"
+
+// --plan: dry run that only reads image headers (stbi_info) and predicts wall time, peak memory
+// and output size from a cost model. The model comes from this host's tuning profile when
+// --autotune has calibrated one, otherwise from conservative built-in rates.
+int RunPlan(const std::string &imgdir, const std::string &imgname, unsigned int threads,
+            const ResizeOptions &options, const CostModel &calibrated);
+
+// Runs the pipeline once per sample on one thread and derives per-stage rates, output bytes per
+// pixel and peak heap per pixel. Used by --autotune.
+CostModel CalibrateCostModel(const std::vector<SampleImage> &samples, const ResizeOptions &options);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "blocking_queue.h"
+#include "image_processor.h"
+
+// --report out.jsonl: one JSON object per processed file. Workers format their own line and
+// hand it over, a dedicated thread does all the file I/O so workers never wait on the disk.
+class ReportWriter
+{
+public:
+    explicit ReportWriter(const std::string &path);
+    ~ReportWriter();
+
+    ReportWriter(const ReportWriter &) = delete;
+    ReportWriter &operator=(const ReportWriter &) = delete;
+
+    bool is_open() const { return file_ != nullptr; }
+
+    // Thread-safe
+    void submit(const ResizeResult &result);
+
+    // Flushes everything submitted so far and stops the writer thread
+    bool close();
+
+private:
+    FILE *file_ = nullptr;
+    BlockingQueue<std::string> lines_;
+    std::thread writer_;
+    bool closed_ = false;
+    bool failed_ = false;
+};
+
+// Escapes a string for use inside a JSON string literal (without the quotes)
+std::string JsonEscape(const std::string &text);
+
+// The report line for one result, without the trailing newline
+std::string FormatReportLine(const ResizeResult &result);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "image_processor.h"
+
+// --cache-dir: content-addressed store of resize results shared across runs, jobs and output
+// directories. An entry is keyed by a 128-bit hash of the input bytes plus ProcessingKey(), and
+// lives at <dir>/<2 hex>/<32 hex><ext>. Hits are copied out with CloneFile (reflink where the
+// filesystem supports it). Entries are evicted least recently used first once the total size
+// passes max_bytes; the last use is the file's mtime so the order survives across runs.
+//
+// Duplicate inputs within one run are resized once: the first worker claims the key and the
+// others wait for it to publish.
+class ResultCache
+{
+public:
+    ResultCache(const std::string &dir, uint64_t max_bytes);
+
+    bool is_open() const { return open_; }
+
+    std::string key_for(const unsigned char *data, size_t length, const std::string &extension,
+                        const ResizeOptions &options) const;
+
+    // True if the caller must produce the entry and then publish() or abandon() it. False when an
+    // entry exists (possibly after waiting for another worker that was producing it).
+    bool claim(const std::string &key, const std::string &extension);
+
+    void publish(const std::string &key, const std::string &extension, const unsigned char *data, size_t length);
+    void abandon(const std::string &key, const std::string &extension);
+
+    // Copy a cached entry out. False if it vanished (evicted by another process).
+    bool fetch_to_file(const std::string &key, const std::string &extension, const std::string &dest);
+    bool fetch(const std::string &key, const std::string &extension, std::vector<unsigned char> &bytes);
+
+    // "hits=.. misses=.. duplicates=.. evicted=.. size=.. MB"
+    std::string summary() const;
+
+private:
+    struct Entry
+    {
+        uint64_t size = 0;
+        int64_t last_use = 0;
+    };
+
+    std::string path_for(const std::string &key, const std::string &extension) const;
+    void touch(const std::string &key, const std::string &extension);
+    void evict_locked();
+
+    std::string dir_;
+    uint64_t max_bytes_;
+    bool open_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable published_;
+    std::unordered_map<std::string, Entry> entries_; // keyed by the entry's file name
+    std::set<std::string> in_flight_;
+    uint64_t total_bytes_ = 0;
+
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> duplicates_{0};
+    std::atomic<uint64_t> evicted_{0};
+};
+
+// ResizeImageBuffer through the cache, a hit fills out_bytes from the stored entry. cache may be null.
+bool CachedResizeImageBuffer(ResultCache *cache, const unsigned char *data, size_t length, const std::string &extension,
+                             const ResizeOptions &options, std::vector<unsigned char> &out_bytes, const std::string &label,
+                             ResizeResult *result);
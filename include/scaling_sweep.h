@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "image_processor.h"
+
+// An encoded input held in memory so measurements don't include disk reads
+struct SampleImage
+{
+    std::string name;
+    std::string extension;
+    std::vector<unsigned char> bytes;
+};
+
+struct ThroughputPoint
+{
+    unsigned int threads = 0;
+    double seconds = 0;
+    double images_per_s = 0;
+    double mp_per_s = 0;
+    uint64_t peak_rss = 0;
+    uint64_t bytes_out = 0; // encoded output of one pass over the samples
+};
+
+// Reads up to max_files supported images (or just imgname) from imgdir, in name order
+std::vector<SampleImage> LoadSampleImages(const std::string &imgdir, const std::string &imgname, size_t max_files);
+
+// Resizes every sample `rounds` times on `threads` threads, outputs are discarded
+ThroughputPoint MeasureThroughput(const std::vector<SampleImage> &samples, const ResizeOptions &options, unsigned int threads, int rounds);
+
+// 1, 2, 4 ... N hardware threads, then N + N/4 and 2N
+std::vector<unsigned int> SweepThreadCounts();
+
+// Passes needed so a measurement lasts at least min_seconds, given one single-threaded pass
+int RoundsForDuration(double single_pass_seconds, double min_seconds);
+
+// --scaling-sweep: runs the same in-memory workload (up to max_files images from imgdir, decoded,
+// resized and encoded without writing anything) at 1, 2, 4 ... N threads plus a couple of
+// oversubscribed counts, and reports throughput, speedup, parallel efficiency and peak RSS for
+// each. Ends with a recommended --threads value for this workload on this machine.
+int RunScalingSweep(const std::string &imgdir, const std::string &imgname, size_t max_files, const ResizeOptions &options);
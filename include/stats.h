@@ -0,0 +1,138 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "perf_counters.h"
+#include "trace.h"
+
+// Per-stage instrumentation for the resize pipeline. Every thread updates its own counters
+// without locks or atomics; CollectStats() sums them once the workers have been joined.
+
+enum Stage
+{
+    STAGE_READ,
+    STAGE_DECODE,
+    STAGE_RESIZE,
+    STAGE_ENCODE,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+
+const char *StageName(Stage stage);
+
+// Log-linear histogram of nanosecond durations: 4 sub-buckets per power of two, so any
+// percentile is within ~12% of the real value at a fixed 2 KB per histogram.
+class LatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 2;
+    static const int BUCKETS = 64 << SUB_BUCKET_BITS;
+
+    void add(uint64_t ns);
+    void merge(const LatencyHistogram &other);
+
+    // q in [0, 1], returns nanoseconds
+    uint64_t percentile(double q) const;
+
+    uint64_t count() const { return count_; }
+    uint64_t total_ns() const { return total_ns_; }
+    uint64_t max_ns() const { return max_ns_; }
+
+private:
+    uint64_t buckets_[BUCKETS] = {};
+    uint64_t count_ = 0;
+    uint64_t total_ns_ = 0;
+    uint64_t max_ns_ = 0;
+};
+
+struct PipelineStats
+{
+    LatencyHistogram stages[STAGE_COUNT];
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t pixels_in = 0;
+    uint64_t pixels_out = 0;
+    uint64_t images = 0;
+    uint64_t failures = 0;
+    uint64_t skipped[STAGE_COUNT] = {}; // stages bypassed because they would not change the image
+    uint64_t passthrough = 0;           // images emitted as the unchanged source
+    uint64_t upscale_avoided = 0;       // --no-upscale kept the input size
+    uint64_t kept_source = 0;           // --keep-smaller emitted the source instead of a larger encode
+    uint64_t gray_collapsed = 0;        // --detect-gray found a colour source to be gray
+    uint64_t alpha_dropped = 0;         // alpha channel was fully opaque and processed without it
+    uint64_t perf[STAGE_COUNT][PERF_COUNTER_COUNT] = {}; // --perf-counters totals per stage
+
+    // largest per-image stb heap peak per stage, and the image with the largest overall peak
+    uint64_t stage_peak_bytes[STAGE_COUNT] = {};
+    uint64_t image_peak_bytes = 0;
+    int image_peak_width = 0;
+    int image_peak_height = 0;
+
+    void merge(const PipelineStats &other);
+    void record_peak_memory(const uint64_t peak_bytes[STAGE_COUNT], int width, int height);
+};
+
+// This thread's counters, registered with the process-wide list on first use
+PipelineStats &LocalStats();
+
+// Sum over every thread that recorded anything. Call after the workers are joined.
+PipelineStats CollectStats();
+
+// --stats summary: totals, per-stage throughput and p50/p90/p99/max latency
+void PrintStatsSummary(const PipelineStats &stats, double elapsed_seconds);
+
+// Resident set size of this process right now, 0 where the platform doesn't expose it cheaply
+uint64_t CurrentRssBytes();
+
+inline uint64_t StatsNowNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Times one stage from construction to stop() (or destruction) into this thread's counters,
+// and into the trace when --trace is on. With --perf-counters the hardware counters are read
+// at both ends as well.
+class StageTimer
+{
+public:
+    explicit StageTimer(Stage stage) : stage_(stage)
+    {
+        if (PerfCountersEnabled())
+            PerfCountersRead(perf_start_);
+        start_ = StatsNowNs();
+    }
+    ~StageTimer() { stop(); }
+
+    StageTimer(const StageTimer &) = delete;
+    StageTimer &operator=(const StageTimer &) = delete;
+
+    // Returns the stage duration in nanoseconds, only the first call records it
+    uint64_t stop()
+    {
+        if (!stopped_)
+        {
+            elapsed_ = StatsNowNs() - start_;
+            PipelineStats &stats = LocalStats();
+            stats.stages[stage_].add(elapsed_);
+            if (PerfCountersEnabled())
+            {
+                PerfSample end;
+                PerfCountersRead(end);
+                PerfCountersAccumulate(perf_start_, end, stats.perf[stage_]);
+            }
+            if (TraceEnabled())
+                TraceRecord(StageName(stage_), start_, elapsed_);
+            stopped_ = true;
+        }
+        return elapsed_;
+    }
+
+private:
+    Stage stage_;
+    uint64_t start_;
+    uint64_t elapsed_ = 0;
+    bool stopped_ = false;
+    PerfSample perf_start_;
+};
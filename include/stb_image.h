@@ -423,6 +423,11 @@ typedef struct
 STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int *x, int *y, int *channels_in_file, int desired_channels);
 
+// ImageCompress: decodes a YCbCr JPEG without upsampling chroma or converting to RGB. Returns one
+// allocation (free with stbi_image_free) holding the Y, Cb and Cr planes back to back, each tightly
+// packed at its own size plane_w[i] x plane_h[i], or NULL if the data isn't a 3-component YCbCr JPEG.
+STBIDEF stbi_uc *stbi_load_jpeg_ycbcr_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int plane_w[3], int plane_h[3]);
+
 #ifndef STBI_NO_STDIO
 STBIDEF stbi_uc *stbi_load            (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
@@ -4039,6 +4044,54 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    return result;
 }
 
+STBIDEF stbi_uc *stbi_load_jpeg_ycbcr_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int plane_w[3], int plane_h[3])
+{
+   stbi__context s;
+   stbi__jpeg *j;
+   stbi_uc *output = NULL;
+   size_t total = 0;
+   int k, row;
+
+   stbi__start_mem(&s,buffer,len);
+   j = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) return stbi__errpuc("outofmem", "Out of memory");
+   memset(j, 0, sizeof(stbi__jpeg));
+   j->s = &s;
+   stbi__setup_jpeg(j);
+   j->s->img_n = 0; // make stbi__cleanup_jpeg safe
+
+   if (stbi__decode_jpeg_image(j)) {
+      // same test as load_jpeg_image: RGB coded scans and CMYK have no YCbCr to keep
+      int is_rgb = j->rgb == 3 || (j->app14_color_transform == 0 && !j->jfif);
+      if (j->s->img_n != 3 || is_rgb) {
+         stbi__err("not ycbcr", "JPEG is not YCbCr");
+      } else {
+         for (k=0; k < 3; ++k) {
+            int hs = j->img_h_max / j->img_comp[k].h, vs = j->img_v_max / j->img_comp[k].v;
+            plane_w[k] = (j->s->img_x + hs-1) / hs;
+            plane_h[k] = (j->s->img_y + vs-1) / vs;
+            total += (size_t) plane_w[k] * plane_h[k];
+         }
+         output = (stbi_uc *) stbi__malloc(total);
+         if (!output) {
+            stbi__err("outofmem", "Out of memory");
+         } else {
+            // the decoded components are padded to whole MCUs, copy out the visible part
+            stbi_uc *dst = output;
+            for (k=0; k < 3; ++k) {
+               for (row=0; row < plane_h[k]; ++row, dst += plane_w[k])
+                  memcpy(dst, j->img_comp[k].data + (size_t) row * j->img_comp[k].w2, plane_w[k]);
+            }
+            *x = j->s->img_x;
+            *y = j->s->img_y;
+         }
+      }
+   }
+   stbi__cleanup_jpeg(j);
+   STBI_FREE(j);
+   return output;
+}
+
 static int stbi__jpeg_test(stbi__context *s)
 {
    int r;
@@ -192,6 +192,12 @@ STBIWDEF int stbi_write_tga_to_func(stbi_write_func *func, void *context, int w,
 STBIWDEF int stbi_write_hdr_to_func(stbi_write_func *func, void *context, int w, int h, int comp, const float *data);
 STBIWDEF int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x, int y, int comp, const void  *data, int quality);
 
+// ImageCompress: writes Y, Cb and Cr planes (JFIF ranges, chroma centred on 128) as they are, with
+// no colour conversion. Each plane is tightly packed; chroma is (x+1)/2 by (y+1)/2 when
+// stbi_write_jpg_subsamples(quality), else x by y like luma.
+STBIWDEF int stbi_write_jpg_ycbcr_to_func(stbi_write_func *func, void *context, int x, int y, const unsigned char *const planes[3], int quality);
+STBIWDEF int stbi_write_jpg_subsamples(int quality);
+
 STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 
 #endif//INCLUDE_STB_IMAGE_WRITE_H
@@ -1395,7 +1401,13 @@ static int stbiw__jpg_processDU(stbi__write_context *s, int *bitBuf, int *bitCnt
    return DU[0];
 }
 
-static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, int comp, const void* data, int quality) {
+STBIWDEF int stbi_write_jpg_subsamples(int quality)
+{
+   return (quality ? quality : 90) <= 90;
+}
+
+// ImageCompress: planes, when not NULL, replaces the interleaved data with planar YCbCr (see stbi_write_jpg_ycbcr_to_func)
+static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, int comp, const void* data, int quality, const unsigned char *const *planes) {
    // Constants that don't pollute global namespace
    static const unsigned char std_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
    static const unsigned char std_dc_luminance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
@@ -1471,12 +1483,15 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
    float fdtbl_Y[64], fdtbl_UV[64];
    unsigned char YTable[64], UVTable[64];
 
+   if(planes) {
+      comp = 3;
+   }
    if(!data || !width || !height || comp > 4 || comp < 1) {
       return 0;
    }
 
+   subsample = stbi_write_jpg_subsamples(quality);
    quality = quality ? quality : 90;
-   subsample = quality <= 90 ? 1 : 0;
    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
    quality = quality < 50 ? 5000 / quality : 200 - quality * 2;
 
@@ -1494,6 +1509,46 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
       }
    }
 
+   // ImageCompress: 1- and 2-channel input (alpha ignored) is written as a single-component
+   // grayscale JPEG rather than YCbCr with flat chroma, a third of the blocks and a smaller file
+   if(comp <= 2) {
+      static const unsigned char gray_head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x43,0 };
+      static const unsigned char gray_head2[] = { 0xFF,0xDA,0,0x8,1,1,0,0,0x3F,0 };
+      const unsigned char gray_head1[] = { 0xFF,0xC0,0,0xB,8,(unsigned char)(height>>8),STBIW_UCHAR(height),(unsigned char)(width>>8),STBIW_UCHAR(width),
+                                           1,1,0x11,0,0xFF,0xC4,0,0xD2,0 };
+      static const unsigned short fillBits[] = {0x7F, 7};
+      const unsigned char *dataY = (const unsigned char *)data;
+      int DCY=0, bitBuf=0, bitCnt=0, x, y, pos;
+
+      s->func(s->context, (void*)gray_head0, sizeof(gray_head0));
+      s->func(s->context, (void*)YTable, sizeof(YTable));
+      s->func(s->context, (void*)gray_head1, sizeof(gray_head1));
+      s->func(s->context, (void*)(std_dc_luminance_nrcodes+1), sizeof(std_dc_luminance_nrcodes)-1);
+      s->func(s->context, (void*)std_dc_luminance_values, sizeof(std_dc_luminance_values));
+      stbiw__putc(s, 0x10); // HTYACinfo
+      s->func(s->context, (void*)(std_ac_luminance_nrcodes+1), sizeof(std_ac_luminance_nrcodes)-1);
+      s->func(s->context, (void*)std_ac_luminance_values, sizeof(std_ac_luminance_values));
+      s->func(s->context, (void*)gray_head2, sizeof(gray_head2));
+
+      for(y = 0; y < height; y += 8) {
+         for(x = 0; x < width; x += 8) {
+            float Y[64];
+            for(row = y, pos = 0; row < y+8; ++row) {
+               int clamped_row = (row < height) ? row : height - 1;
+               int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
+               for(col = x; col < x+8; ++col, ++pos) {
+                  Y[pos] = dataY[base_p + ((col < width) ? col : (width-1))*comp] - 128.0f;
+               }
+            }
+            DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y, 8, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+         }
+      }
+      stbiw__jpg_writeBits(s, &bitBuf, &bitCnt, fillBits);
+      stbiw__putc(s, 0xFF);
+      stbiw__putc(s, 0xD9);
+      return 1;
+   }
+
    // Write Headers
    {
       static const unsigned char head0[] = { 0xFF,0xD8,0xFF,0xE0,0,0x10,'J','F','I','F',0,1,1,0,0,1,0,1,0,0,0xFF,0xDB,0,0x84,0 };
@@ -1530,42 +1585,64 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
       const unsigned char *dataG = dataR + ofsG;
       const unsigned char *dataB = dataR + ofsB;
       int x, y, pos;
+      // chroma plane size for planar input
+      int cw = subsample ? (width+1)/2 : width, ch = subsample ? (height+1)/2 : height;
       if(subsample) {
          for(y = 0; y < height; y += 16) {
             for(x = 0; x < width; x += 16) {
                float Y[256], U[256], V[256];
-               for(row = y, pos = 0; row < y+16; ++row) {
-                  // row >= height => use last input row
-                  int clamped_row = (row < height) ? row : height - 1;
-                  int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
-                  for(col = x; col < x+16; ++col, ++pos) {
-                     // if col >= width => use pixel from last input column
-                     int p = base_p + ((col < width) ? col : (width-1))*comp;
-                     float r = dataR[p], g = dataG[p], b = dataB[p];
-                     Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
-                     U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
-                     V[pos]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
-                  }
-               }
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+0,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+8,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
-
-               // subsample U,V
-               {
-                  float subU[64], subV[64];
+               float subU[64], subV[64];
+               if(planes) {
                   int yy, xx;
+                  for(row = y, pos = 0; row < y+16; ++row) {
+                     int clamped_row = (row < height) ? row : height - 1;
+                     const unsigned char *line = planes[0] + (size_t)(stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width;
+                     for(col = x; col < x+16; ++col, ++pos) {
+                        Y[pos] = line[(col < width) ? col : (width-1)] - 128.0f;
+                     }
+                  }
                   for(yy = 0, pos = 0; yy < 8; ++yy) {
+                     int crow = (y/2+yy < ch) ? y/2+yy : ch - 1;
+                     size_t base_c = (size_t)(stbi__flip_vertically_on_write ? (ch-1-crow) : crow)*cw;
                      for(xx = 0; xx < 8; ++xx, ++pos) {
-                        int j = yy*32+xx*2;
-                        subU[pos] = (U[j+0] + U[j+1] + U[j+16] + U[j+17]) * 0.25f;
-                        subV[pos] = (V[j+0] + V[j+1] + V[j+16] + V[j+17]) * 0.25f;
+                        size_t c = base_c + ((x/2+xx < cw) ? x/2+xx : (cw-1));
+                        subU[pos] = planes[1][c] - 128.0f;
+                        subV[pos] = planes[2][c] - 128.0f;
+                     }
+                  }
+               } else {
+                  for(row = y, pos = 0; row < y+16; ++row) {
+                     // row >= height => use last input row
+                     int clamped_row = (row < height) ? row : height - 1;
+                     int base_p = (stbi__flip_vertically_on_write ? (height-1-clamped_row) : clamped_row)*width*comp;
+                     for(col = x; col < x+16; ++col, ++pos) {
+                        // if col >= width => use pixel from last input column
+                        int p = base_p + ((col < width) ? col : (width-1))*comp;
+                        float r = dataR[p], g = dataG[p], b = dataB[p];
+                        Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
+                        U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
+                        V[pos]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
+                     }
+                  }
+
+                  // subsample U,V
+                  {
+                     int yy, xx;
+                     for(yy = 0, pos = 0; yy < 8; ++yy) {
+                        for(xx = 0; xx < 8; ++xx, ++pos) {
+                           int j = yy*32+xx*2;
+                           subU[pos] = (U[j+0] + U[j+1] + U[j+16] + U[j+17]) * 0.25f;
+                           subV[pos] = (V[j+0] + V[j+1] + V[j+16] + V[j+17]) * 0.25f;
+                        }
                      }
                   }
-                  DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
-                  DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
                }
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+0,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+8,   16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+               DCY = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, Y+136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+               DCU = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+               DCV = stbiw__jpg_processDU(s, &bitBuf, &bitCnt, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
             }
          }
       } else {
@@ -1579,10 +1656,17 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
                   for(col = x; col < x+8; ++col, ++pos) {
                      // if col >= width => use pixel from last input column
                      int p = base_p + ((col < width) ? col : (width-1))*comp;
-                     float r = dataR[p], g = dataG[p], b = dataB[p];
-                     Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
-                     U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
-                     V[pos]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
+                     if(planes) {
+                        // full resolution chroma, p / comp is the plane offset
+                        Y[pos] = planes[0][p / comp] - 128.0f;
+                        U[pos] = planes[1][p / comp] - 128.0f;
+                        V[pos] = planes[2][p / comp] - 128.0f;
+                     } else {
+                        float r = dataR[p], g = dataG[p], b = dataB[p];
+                        Y[pos]= +0.29900f*r + 0.58700f*g + 0.11400f*b - 128;
+                        U[pos]= -0.16874f*r - 0.33126f*g + 0.50000f*b;
+                        V[pos]= +0.50000f*r - 0.41869f*g - 0.08131f*b;
+                     }
                   }
                }
 
@@ -1608,7 +1692,15 @@ STBIWDEF int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x,
 {
    stbi__write_context s = { 0 };
    stbi__start_write_callbacks(&s, func, context);
-   return stbi_write_jpg_core(&s, x, y, comp, (void *) data, quality);
+   return stbi_write_jpg_core(&s, x, y, comp, (void *) data, quality, NULL);
+}
+
+STBIWDEF int stbi_write_jpg_ycbcr_to_func(stbi_write_func *func, void *context, int x, int y, const unsigned char *const planes[3], int quality)
+{
+   stbi__write_context s = { 0 };
+   if (!planes || !planes[0] || !planes[1] || !planes[2]) return 0;
+   stbi__start_write_callbacks(&s, func, context);
+   return stbi_write_jpg_core(&s, x, y, 3, planes[0], quality, planes);
 }
 
 
@@ -1617,7 +1709,7 @@ STBIWDEF int stbi_write_jpg(char const *filename, int x, int y, int comp, const
 {
    stbi__write_context s = { 0 };
    if (stbi__start_write_file(&s,filename)) {
-      int r = stbi_write_jpg_core(&s, x, y, comp, data, quality);
+      int r = stbi_write_jpg_core(&s, x, y, comp, data, quality, NULL);
       stbi__end_write_file(&s);
       return r;
    } else
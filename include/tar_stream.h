@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// One regular file taken out of (or going into) a tar archive
+struct TarMember
+{
+    std::string name;
+    std::vector<unsigned char> data;
+};
+
+// Turns an archive member name into a relative path that stays inside the output root.
+// Leading '/' and "." components are dropped, returns "" if the name would escape via "..".
+std::string SafeMemberPath(const std::string &name);
+
+// Sequential reader for ustar / GNU / pax archives. Only regular file members are
+// returned, directories, links and other entries are skipped. "-" reads from stdin.
+class TarReader
+{
+public:
+    explicit TarReader(const std::string &path);
+    ~TarReader();
+
+    TarReader(const TarReader &) = delete;
+    TarReader &operator=(const TarReader &) = delete;
+
+    bool is_open() const { return file_ != nullptr; }
+
+    // Reads the next regular file member. Returns false at the end of the archive or on a
+    // corrupt header, check error() to tell the two apart.
+    bool next(TarMember &member);
+
+    const std::string &error() const { return error_; }
+
+private:
+    bool read_block(unsigned char *block);
+    bool read_payload(size_t size, std::vector<unsigned char> &data);
+    bool skip_payload(size_t size);
+
+    FILE *file_ = nullptr;
+    bool owns_file_ = false;
+    std::string error_;
+};
+
+// Sequential ustar writer. Names longer than the ustar limits get a GNU long name entry.
+// Not thread-safe, ImageCompress drives it from a single writer thread. "-" writes to stdout.
+class TarWriter
+{
+public:
+    explicit TarWriter(const std::string &path);
+    ~TarWriter();
+
+    TarWriter(const TarWriter &) = delete;
+    TarWriter &operator=(const TarWriter &) = delete;
+
+    bool is_open() const { return file_ != nullptr; }
+
+    bool append(const std::string &name, const unsigned char *data, size_t length);
+
+    // Writes the end-of-archive marker and flushes. Called by the destructor if needed.
+    bool finish();
+
+private:
+    bool write_header(const std::string &name, size_t length, char type);
+    bool write_padded(const unsigned char *data, size_t length);
+
+    FILE *file_ = nullptr;
+    bool owns_file_ = false;
+    bool finished_ = false;
+};
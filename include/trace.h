@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// --trace: per-file, per-stage spans in Chrome trace-event format (chrome://tracing, Perfetto).
+// Every thread records into its own fixed-size ring buffer, so tracing is a clock read and a
+// 64-byte store per span. When a ring fills up the oldest spans are overwritten.
+
+extern bool g_trace_enabled;
+
+inline bool TraceEnabled()
+{
+    return g_trace_enabled;
+}
+
+// Must be called before any worker thread starts
+void TraceEnable();
+
+// Shows up as the thread's name in the viewer, e.g. "worker"
+void TraceSetThreadName(const char *name);
+
+// Records a finished span on this thread, tagged with the thread's current file
+void TraceRecord(const char *name, uint64_t start_ns, uint64_t duration_ns);
+
+// Records a span from construction to destruction. A non-empty label becomes the thread's
+// current file for every span recorded inside this scope.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, const std::string &label = std::string());
+    ~TraceScope();
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+    const char *name_;
+    uint64_t start_ = 0;
+    bool labelled_ = false;
+};
+
+// Writes every thread's spans as a Chrome trace JSON file. Call after the workers are joined.
+bool TraceWrite(const std::string &path);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+// Per-host settings found by --autotune. Stored as key=value lines in
+// ~/.config/imagecompress/tune-<hostname>.conf (%APPDATA%\imagecompress on Windows) and applied
+// automatically on later runs; explicit --threads / --png-level / --png-filter flags win.
+// Single-core rates measured on this host by --autotune and used by --plan. 0 = not calibrated.
+struct CostModel
+{
+    double decode_jpeg_mps = 0;      // input megapixels per second
+    double decode_png_mps = 0;
+    double resize_mps = 0;           // input megapixels per second
+    double encode_jpeg_mps = 0;      // output megapixels per second
+    double encode_png_mps = 0;
+    double jpeg_bytes_per_pixel = 0; // encoded output bytes per output pixel
+    double png_bytes_per_pixel = 0;
+    int jpeg_quality = 0;            // quality jpeg_bytes_per_pixel was measured at
+    double peak_bytes_per_pixel = 0; // stb heap peak per input pixel
+
+    bool calibrated() const { return decode_jpeg_mps > 0 || decode_png_mps > 0; }
+};
+
+struct TuningProfile
+{
+    std::string host;
+    unsigned int cores = 0;   // hardware threads when the profile was made, a mismatch invalidates it
+    unsigned int threads = 0; // 0 = not tuned
+    int png_level = 8;
+    int png_filter = -1;
+    double images_per_s = 0;  // calibration result, informational
+    CostModel model;
+};
+
+std::string HostName();
+
+std::string DefaultTuningProfilePath();
+
+// False if the file is missing or unreadable; unknown keys are ignored
+bool LoadTuningProfile(const std::string &path, TuningProfile &profile);
+
+bool SaveTuningProfile(const std::string &path, const TuningProfile &profile);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include "image_processor.h"
+
+// --watch: keeps the worker pool alive and uses inotify (IN_CLOSE_WRITE / IN_MOVED_TO) on imgdir
+// to resize files as soon as they are complete. Repeated events for the same path within
+// debounce_ms collapse into one job. Enqueue-to-written latency is reported periodically and on exit.
+// Linux only. Blocks until SIGINT/SIGTERM and returns the process exit code.
+int RunWatchMode(const std::string &imgdir,
+                 const std::string &outdir,
+                 bool recursive,
+                 int debounce_ms,
+                 unsigned int threads,
+                 const ResizeOptions &options);
@@ -0,0 +1,86 @@
+#include "alloc_tracker.h"
+#include <cstdlib>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+// Every block carries its size in front so free() can account for it. 16 bytes keeps the
+// alignment malloc guarantees, the SIMD paths in stb_image_resize2 rely on it.
+static const size_t ALLOC_HEADER = 16;
+
+static thread_local uint64_t alloc_current = 0;
+static thread_local uint64_t alloc_peak = 0;
+
+static void *track(void *block, size_t size)
+{
+    if (block == nullptr)
+        return nullptr;
+    *(size_t *)block = size;
+    alloc_current += size;
+    if (alloc_current > alloc_peak)
+        alloc_peak = alloc_current;
+    return (unsigned char *)block + ALLOC_HEADER;
+}
+
+static void untrack(size_t size)
+{
+    // a block freed on another thread than the one that allocated it must not wrap the count
+    alloc_current = alloc_current >= size ? alloc_current - size : 0;
+}
+
+void *AllocTrackedMalloc(size_t size)
+{
+    return track(std::malloc(size + ALLOC_HEADER), size);
+}
+
+void *AllocTrackedRealloc(void *pointer, size_t size)
+{
+    if (pointer == nullptr)
+        return AllocTrackedMalloc(size);
+
+    unsigned char *block = (unsigned char *)pointer - ALLOC_HEADER;
+    const size_t old_size = *(size_t *)block;
+    void *resized = std::realloc(block, size + ALLOC_HEADER);
+    if (resized == nullptr)
+        return nullptr; // the old block is still valid and still counted
+
+    untrack(old_size);
+    return track(resized, size);
+}
+
+void AllocTrackedFree(void *pointer)
+{
+    if (pointer == nullptr)
+        return;
+
+    unsigned char *block = (unsigned char *)pointer - ALLOC_HEADER;
+    untrack(*(size_t *)block);
+    std::free(block);
+}
+
+uint64_t AllocCurrentBytes()
+{
+    return alloc_current;
+}
+
+uint64_t AllocPeakBytes()
+{
+    return alloc_peak;
+}
+
+void AllocResetPeak()
+{
+    alloc_peak = alloc_current;
+}
+
+uint64_t PeakRssBytes()
+{
+#ifdef __linux__
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (uint64_t)usage.ru_maxrss * 1024; // kilobytes on Linux
+#else
+    return 0;
+#endif
+}
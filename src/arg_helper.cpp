@@ -24,9 +24,46 @@ Optional Arguments:
   --width <pixels>       Resize to a specific width, keeping aspect ratio.
   --height <pixels>      Resize to a specific height, keeping aspect ratio.
                          (NOTE: Only one resize option: --size-factor, --width, or --height)
+  --no-upscale           Keep images already within the target size at their size.
+  --keep-smaller         Keep the source when the resized output would not be smaller.
+  --detect-gray          Process colour images that are visually gray as single-channel.
+  --fast-alpha           Faster resize of transparent images; colour under fully clear pixels may change.
+  --prefilter <auto|off> Halve big images with a box filter before the final resize. (default: auto)
+  --filter <name>        Resampling filter: box, triangle, cubic, catmull, mitchell, point. (default: stb's choice)
+  --colorspace <space>   srgb filters in linear light, linear filters the stored values (faster). (default: srgb)
+  --resize-engine <name> stb (float), or fixed: int16 fixed point, faster for gray and RGB. (default: stb)
+  --jpeg-planar <auto|off>
+                         JPEG to JPEG as Y/Cb/Cr planes, no colour conversion (with --colorspace linear,
+                         or when not resizing). (default: auto)
 
   --imgname <file>       Specify a single image filename to process from the imgdir.
+  --input-tar <file|->   Read images from a tar archive (or stdin) instead of --imgdir.
+  --output-tar <file|->  Write results into a tar archive (or stdout) instead of --outdir.
+  --output-pack <file>   Append results into one packed blob plus a sorted <file>.idx index.
+  --serve <socket>       Run as a daemon with a warm worker pool, taking jobs over a Unix socket.
+                         Size/quality options become the per-job defaults.
+  --http <port>          Serve GET /resize?src=..&w=..&h=..&q=.. on 127.0.0.1, src relative to --imgdir.
+  --http-cache-mb <n>    Size of the --http in-memory result cache. (default: 256)
+  --watch                Keep running and resize files as they arrive in --imgdir (Linux, inotify).
+  --recursive            With --watch, also watch sub folders (mirrored under --outdir).
+  --debounce-ms <ms>     With --watch, wait this long after the last event for a file. (default: 200)
+  --pack-get <pack> <name>
+                         Look up <name> in a pack and write its bytes to stdout.
   --threads <num>        Number of threads to use. (default: CPU cores - 2)
+  --stats                Print per-stage timing, throughput and latency percentiles at the end.
+  --perf-counters        With --stats, add cycles, IPC, LLC and branch misses per stage (Linux perf_event_open).
+  --trace <file.json>    Record per-file, per-stage spans per thread in Chrome trace-event format.
+  --scaling-sweep        Time the --imgdir images at 1, 2, 4 ... N and N+k threads and recommend --threads.
+  --sweep-files <num>    With --scaling-sweep or --autotune, use at most this many images. (default: 200)
+  --plan                 Read only the --imgdir headers and predict time, peak memory and output size.
+  --autotune             Calibrate threads and PNG settings on --imgdir and save them as this host's profile.
+  --profile <file>       Tuning profile to write/read. (default: ~/.config/imagecompress/tune-<host>.conf)
+  --no-profile           Ignore the tuning profile for this run.
+  --png-level <1-9>      PNG zlib compression level. (default: profile, else 8)
+  --png-filter <-1..4>   PNG row filter, -1 picks per row. (default: profile, else -1)
+  --report <file.jsonl>  Write one JSON line per file: status, dimensions, bytes and stage timings.
+  --cache-dir <dir>      Reuse results for inputs already resized with the same settings, across runs.
+  --cache-max-mb <num>   Evict least recently used cache entries above this size. (default: 1024)
   -h, --help             Show this help message and exit.
 
 Examples:
@@ -36,27 +73,49 @@ Examples:
   linux:
     $ ./ImageCompress --imgdir /path/to/images --outdir /path/to/output --height 600 --quality 75
     $ ./ImageCompress --imgdir /home/user/images --outdir /home/user/output --imgname photo.png --quality 85
+    $ tar -cf - photos | ./ImageCompress --input-tar - --output-tar thumbs.tar --width 256
 )";
 }
 
 bool validate_params(const std::string &_imgdir,
                      const std::string &_outdir,
-                     int _size,
-                     int _quality,
-                     int _width,
-                     int _height)
+                     const std::string &_input_tar,
+                     const std::string &_output_tar,
+                     const std::string &_output_pack)
 {
-    if (_imgdir.empty() || _outdir.empty())
+    const int outputs = !_outdir.empty() + !_output_tar.empty() + !_output_pack.empty();
+    if ((_imgdir.empty() && _input_tar.empty()) || outputs == 0)
     {
-        cout << "Error: ****  --imgdir, --outdir, --size, and --quality are required parameters." << endl;
+        cout << "Error: ****  --imgdir (or --input-tar) and --outdir (or --output-tar / --output-pack) are required parameters." << endl;
         print_help_msg();
         return false;
     }
-    if (!std::filesystem::exists(_imgdir))
+    if (!_imgdir.empty() && !_input_tar.empty())
+    {
+        cout << "Error: Only one of --imgdir or --input-tar should be specified." << endl;
+        return false;
+    }
+    if (outputs > 1)
+    {
+        cout << "Error: Only one of --outdir, --output-tar or --output-pack should be specified." << endl;
+        return false;
+    }
+    if (!_input_tar.empty() && _input_tar != "-" && !std::filesystem::exists(_input_tar))
+    {
+        cout << "Error: Specified input tar does not exist: " << _input_tar << endl;
+        return false;
+    }
+    if (_input_tar.empty() && !std::filesystem::exists(_imgdir))
     {
         cout << "Error: Specified image directory does not exist: " << _imgdir << endl;
         return false;
     }
+    return true; // All validation passed
+}
+
+// Size and quality checks, shared by every mode including the servers and the sweeps
+bool validate_resize_params(int _size, int _quality, int _width, int _height)
+{
     if (_size <= 0)
     {
         cout << "Error: --size must be a positive integer." << endl;
@@ -93,5 +152,5 @@ bool validate_params(const std::string &_imgdir,
         return false;
     }
 
-    return true; // All validation passed
+    return true;
 }
@@ -0,0 +1,162 @@
+#include "autotune.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "planner.h"
+#include "scaling_sweep.h"
+#include "tuning_profile.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// every candidate runs at least this long, the whole search stays well under a minute on small samples
+static const double MIN_CANDIDATE_SECONDS = 1.0;
+
+// candidates this close to the fastest are treated as ties and the cheaper one wins
+static const double TIE_TOLERANCE = 0.03;
+
+// PNG settings may not grow the output more than this over stb's defaults
+static const double MAX_PNG_GROWTH = 0.03;
+
+static const int DEFAULT_PNG_LEVEL = 8;
+static const int DEFAULT_PNG_FILTER = -1;
+
+static void print_candidate(const char *what, const ThroughputPoint &point, uint64_t baseline_bytes)
+{
+    char line[160];
+    if (baseline_bytes > 0)
+        std::snprintf(line, sizeof(line), "  %-22s %10.1f images/s %10.1f MP/s   size %+6.2f%%", what, point.images_per_s,
+                      point.mp_per_s, 100.0 * ((double)point.bytes_out / baseline_bytes - 1.0));
+    else
+        std::snprintf(line, sizeof(line), "  %-22s %10.1f images/s %10.1f MP/s", what, point.images_per_s, point.mp_per_s);
+    cout << line << endl;
+}
+
+// Fastest PNG setting among candidates that keep the output size within MAX_PNG_GROWTH. The
+// default wins ties, so the profile only deviates from stb when it is measurably faster.
+template <typename Apply>
+static int pick_png_setting(const std::vector<SampleImage> &pngs, const ResizeOptions &options, unsigned int threads,
+                            int rounds, const std::vector<int> &candidates, int fallback, const char *label, Apply apply,
+                            uint64_t baseline_bytes)
+{
+    std::vector<ThroughputPoint> points;
+    for (int candidate : candidates)
+    {
+        apply(candidate);
+        points.push_back(MeasureThroughput(pngs, options, threads, rounds));
+        print_candidate((string(label) + " " + std::to_string(candidate)).c_str(), points.back(), baseline_bytes);
+    }
+
+    int best = fallback;
+    double best_rate = 0, fallback_rate = 0;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (points[i].bytes_out > baseline_bytes * (1.0 + MAX_PNG_GROWTH))
+            continue;
+        if (candidates[i] == fallback)
+            fallback_rate = points[i].images_per_s;
+        if (points[i].images_per_s > best_rate)
+        {
+            best = candidates[i];
+            best_rate = points[i].images_per_s;
+        }
+    }
+    if (fallback_rate >= best_rate * (1.0 - TIE_TOLERANCE))
+        best = fallback;
+
+    apply(best);
+    return best;
+}
+
+// Scales the single-thread rounds so a run on `threads` threads still lasts about as long
+static int rounds_for_threads(int rounds, unsigned int threads, unsigned int cores)
+{
+    return rounds * (int)std::min(threads, cores);
+}
+
+int RunAutotune(const std::string &imgdir, const std::string &imgname, size_t max_files,
+                const ResizeOptions &options, const std::string &profile_path)
+{
+    const std::vector<SampleImage> samples = LoadSampleImages(imgdir, imgname, max_files);
+    if (samples.empty())
+    {
+        cout << "Error: No supported images found in " << imgdir << endl;
+        return 1;
+    }
+
+    TuningProfile profile;
+    profile.host = HostName();
+    profile.cores = std::max(1u, std::thread::hardware_concurrency());
+    SetPngEncoderOptions(DEFAULT_PNG_LEVEL, DEFAULT_PNG_FILTER);
+
+    cout << "Autotuning on " << samples.size() << " images from " << imgdir << " (" << profile.host << ", "
+         << profile.cores << " hardware threads)" << endl;
+
+    const ThroughputPoint warmup = MeasureThroughput(samples, options, 1, 1);
+    const int rounds = RoundsForDuration(warmup.seconds, MIN_CANDIDATE_SECONDS);
+
+    // 1. threads: the fewest that get within the tie tolerance of the best
+    cout << "Threads:" << endl;
+    std::vector<ThroughputPoint> points;
+    for (unsigned int threads : SweepThreadCounts())
+    {
+        points.push_back(MeasureThroughput(samples, options, threads, rounds_for_threads(rounds, threads, profile.cores)));
+        print_candidate(("threads " + std::to_string(threads)).c_str(), points.back(), 0);
+    }
+    double best_rate = 0;
+    for (const ThroughputPoint &point : points)
+        best_rate = std::max(best_rate, point.images_per_s);
+    for (const ThroughputPoint &point : points)
+    {
+        if (point.images_per_s >= best_rate * (1.0 - TIE_TOLERANCE))
+        {
+            profile.threads = point.threads;
+            break;
+        }
+    }
+
+    // 2. PNG encoder, only measured on the PNG part of the sample since JPEG output doesn't use it
+    std::vector<SampleImage> pngs;
+    for (const SampleImage &sample : samples)
+        if (sample.extension == ".png")
+            pngs.push_back(sample);
+
+    if (!pngs.empty())
+    {
+        const ThroughputPoint png_warmup = MeasureThroughput(pngs, options, 1, 1);
+        const int png_rounds = rounds_for_threads(RoundsForDuration(png_warmup.seconds, MIN_CANDIDATE_SECONDS),
+                                                  profile.threads, profile.cores);
+        const uint64_t baseline_bytes = png_warmup.bytes_out;
+
+        cout << "PNG compression level (" << pngs.size() << " PNGs):" << endl;
+        profile.png_level = pick_png_setting(pngs, options, profile.threads, png_rounds, {1, 3, 5, 6, 7, 8}, DEFAULT_PNG_LEVEL,
+                                             "level", [&](int level) { SetPngEncoderOptions(level, DEFAULT_PNG_FILTER); },
+                                             baseline_bytes);
+
+        cout << "PNG row filter (-1 = adaptive):" << endl;
+        profile.png_filter = pick_png_setting(pngs, options, profile.threads, png_rounds, {-1, 0, 1, 2, 4}, DEFAULT_PNG_FILTER,
+                                              "filter", [&](int filter) { SetPngEncoderOptions(profile.png_level, filter); },
+                                              baseline_bytes);
+    }
+
+    SetPngEncoderOptions(profile.png_level, profile.png_filter);
+    const ThroughputPoint tuned =
+        MeasureThroughput(samples, options, profile.threads, rounds_for_threads(rounds, profile.threads, profile.cores));
+    profile.images_per_s = tuned.images_per_s;
+    profile.model = CalibrateCostModel(samples, options);
+
+    cout << endl << "Best: threads=" << profile.threads << " png_level=" << profile.png_level
+         << " png_filter=" << profile.png_filter << " (" << (int)tuned.images_per_s << " images/s, "
+         << (int)warmup.images_per_s << " with 1 thread and defaults)" << endl;
+
+    if (!SaveTuningProfile(profile_path, profile))
+    {
+        cout << "ERROR **** Failed to write tuning profile: " << profile_path << endl;
+        return 1;
+    }
+    cout << "Profile written to " << profile_path << ", later runs on this host load it automatically" << endl;
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "file_helpers.h"
+#include <cstdio>
+#include <filesystem>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool ReadFileBytes(const std::string &filepath, std::vector<unsigned char> &bytes)
+{
+    FILE *file = std::fopen(filepath.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    std::error_code ec;
+    const auto file_size = std::filesystem::file_size(filepath, ec);
+    bytes.resize(ec ? 0 : static_cast<size_t>(file_size));
+
+    size_t read = bytes.empty() ? 0 : std::fread(bytes.data(), 1, bytes.size(), file);
+    bool ok = read == bytes.size() && !std::ferror(file);
+    std::fclose(file);
+
+    bytes.resize(read);
+    return ok;
+}
+
+bool WriteFileBytes(const std::string &filepath, const unsigned char *data, size_t length)
+{
+    FILE *file = std::fopen(filepath.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    bool ok = length == 0 || std::fwrite(data, 1, length, file) == length;
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+}
+
+#ifdef __linux__
+// Reflink or in-kernel copy, false if neither worked and the caller should copy by hand
+static bool clone_in_kernel(const std::string &src, const std::string &dest)
+{
+    const int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        return false;
+    struct stat st;
+    const int out = ::fstat(in, &st) == 0 ? ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+    if (out < 0)
+    {
+        ::close(in);
+        return false;
+    }
+
+    bool ok = ::ioctl(out, FICLONE, in) == 0;
+    if (!ok)
+    {
+        off_t remaining = st.st_size;
+        while (remaining > 0)
+        {
+            const ssize_t copied = ::copy_file_range(in, nullptr, out, nullptr, (size_t)remaining, 0);
+            if (copied <= 0)
+                break;
+            remaining -= copied;
+        }
+        ok = remaining == 0;
+    }
+    ok = ::close(out) == 0 && ok;
+    ::close(in);
+    return ok;
+}
+#endif
+
+bool CloneFile(const std::string &src, const std::string &dest)
+{
+#ifdef __linux__
+    if (clone_in_kernel(src, dest))
+        return true;
+#endif
+    std::error_code ec;
+    return std::filesystem::copy_file(src, dest, std::filesystem::copy_options::overwrite_existing, ec) && !ec;
+}
+
+bool IsSupportedImage(const std::string &filepath)
+{
+    const std::string extension = std::filesystem::path(filepath).extension().string();
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png";
+}
@@ -0,0 +1,642 @@
+#include "fixed_resize.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#include "alloc_tracker.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FIXED_RESIZE_SSE2 1
+#endif
+#if defined(FIXED_RESIZE_SSE2) && defined(__GNUC__)
+#include <immintrin.h>
+#define FIXED_RESIZE_AVX2 1
+#endif
+
+// coefficients of one output pixel sum to 1 << COEFF_BITS
+static const int COEFF_BITS = 14;
+static const int COEFF_ROUND = 1 << (COEFF_BITS - 1);
+
+// pixels are 0..VALUE_MAX between the lookup tables, which leaves int16 room for filter overshoot
+static const int VALUE_BITS = 14;
+static const int VALUE_MAX = (1 << VALUE_BITS) - 1;
+
+// --colorspace linear stores v << 6, which a shift undoes exactly and SIMD can widen without a table
+static const int PLAIN_SHIFT = 6;
+
+// RGB is carried as 4 lanes, the 4th always 0. Input rows are stored as pixel pairs interleaved
+// r0 r1 g0 g1 b0 b1 0 0, exactly what pmaddwd wants against (c0, c1) weight pairs, and the taps of
+// every output pixel start on an even pixel so they always line up with a pair.
+static const int RGB_LANES = 4;
+
+// horizontal taps are zero padded to these multiples so the kernels never need a tail loop
+static const int GRAY_TAP_MULTIPLE = 16;
+static const int RGB_TAP_MULTIPLE = 4;
+
+// Kernels and supports as stbir defines them, x in the space the kernel is measured in. scale is
+// only used by the box (trapezoid) kernel, which widens its ramps as the image shrinks.
+static double filter_kernel(ResizeFilter filter, double x, double scale)
+{
+    x = std::fabs(x);
+    switch (filter)
+    {
+    case FILTER_BOX:
+    {
+        const double t = 0.5 + scale / 2;
+        if (x >= t)
+            return 0;
+        return x <= 0.5 - scale / 2 ? 1 : (t - x) / scale;
+    }
+    case FILTER_TRIANGLE:
+        return x <= 1 ? 1 - x : 0;
+    case FILTER_CUBIC:
+        if (x < 1)
+            return (4 + x * x * (3 * x - 6)) / 6;
+        return x < 2 ? (8 + x * (-12 + x * (6 - x))) / 6 : 0;
+    case FILTER_CATMULL:
+        if (x < 1)
+            return 1 - x * x * (2.5 - 1.5 * x);
+        return x < 2 ? 2 - x * (4 + x * (0.5 * x - 2.5)) : 0;
+    default: // FILTER_MITCHELL
+        if (x < 1)
+            return (16 + x * x * (21 * x - 36)) / 18;
+        return x < 2 ? (32 + x * (-60 + x * (36 - 7 * x))) / 18 : 0;
+    }
+}
+
+static double filter_support(ResizeFilter filter, double scale)
+{
+    switch (filter)
+    {
+    case FILTER_BOX:
+        return 0.5 + scale / 2;
+    case FILTER_TRIANGLE:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+// Contributors of one axis: output pixel i reads count[i] input pixels from first[i] with the
+// int16 weights at weights(i). Output pixels in the same phase share one row of weights, so for
+// common ratios (4000 -> 256 has 8 phases) the table stays in L1 however wide the image is.
+struct FixedAxis
+{
+    std::vector<int> first;
+    std::vector<int> count;
+    std::vector<uint32_t> offset; // start of each output pixel's row in coeffs
+    std::vector<int16_t> coeffs;
+    int width = 0;     // taps per row in coeffs, the zero padded maximum count
+    int max_count = 0;
+
+    const int16_t *weights(int i) const { return &coeffs[offset[i]]; }
+};
+
+// Same geometry as stbir with its default clamp edge: pixel centres at +0.5, the kernel measured
+// in output pixels when shrinking and input pixels when enlarging, taps past an edge folded onto
+// the edge pixel, and zero weights trimmed from both ends. Weights are normalised, rounded to
+// COEFF_BITS and the rounding error is given to the largest tap so every row sums exactly to one.
+static void build_axis(FixedAxis &axis, int input_size, int output_size, ResizeFilter filter, int tap_multiple,
+                       bool even_first)
+{
+    const double scale = (double)output_size / input_size;
+    const bool shrink = scale < 1;
+    if (filter == FILTER_DEFAULT)
+        filter = shrink ? FILTER_MITCHELL : FILTER_CATMULL;
+    const double kernel_scale = shrink ? scale : 1 / scale;
+    const double radius = shrink ? filter_support(filter, scale) / scale : filter_support(filter, kernel_scale);
+
+    std::vector<std::vector<double>> weights(output_size);
+    axis.first.assign(output_size, 0);
+    axis.count.assign(output_size, 0);
+    axis.max_count = 0;
+    for (int i = 0; i < output_size; ++i)
+    {
+        const double center = (i + 0.5) / scale;
+        const int low = (int)std::floor(center - radius + 0.5);
+        const int high = std::max(low, (int)std::floor(center + radius - 0.5));
+
+        const int first = std::clamp(low, 0, input_size - 1);
+        std::vector<double> &w = weights[i];
+        w.assign(std::clamp(high, 0, input_size - 1) - first + 1, 0.0);
+        for (int j = low; j <= high; ++j)
+        {
+            const double x = (j + 0.5 - center) * (shrink ? scale : 1);
+            w[std::clamp(j, 0, input_size - 1) - first] += filter_kernel(filter, x, kernel_scale);
+        }
+
+        size_t begin = 0, end = w.size();
+        while (end - begin > 1 && std::fabs(w[begin]) < 1e-8)
+            begin++;
+        while (end - begin > 1 && std::fabs(w[end - 1]) < 1e-8)
+            end--;
+        w = std::vector<double>(w.begin() + begin, w.begin() + end);
+        axis.first[i] = first + (int)begin;
+        if (even_first && axis.first[i] % 2 != 0)
+        {
+            w.insert(w.begin(), 0.0);
+            axis.first[i]--;
+        }
+        axis.count[i] = (int)w.size();
+        axis.max_count = std::max(axis.max_count, axis.count[i]);
+    }
+
+    axis.width = (axis.max_count + tap_multiple - 1) / tap_multiple * tap_multiple;
+    axis.offset.assign(output_size, 0);
+    axis.coeffs.clear();
+
+    // the kernel positions repeat every `period` output pixels; rows only differ near the edges
+    const int period = output_size / std::gcd(input_size, output_size);
+    std::vector<int16_t> row(axis.width);
+    for (int i = 0; i < output_size; ++i)
+    {
+        const std::vector<double> &w = weights[i];
+        double sum = 0;
+        for (double weight : w)
+            sum += weight;
+        if (sum == 0)
+            sum = 1;
+
+        std::fill(row.begin(), row.end(), 0);
+        int total = 0;
+        size_t largest = 0;
+        for (size_t k = 0; k < w.size(); ++k)
+        {
+            row[k] = (int16_t)std::lround(w[k] / sum * (1 << COEFF_BITS));
+            total += row[k];
+            if (row[k] > row[largest])
+                largest = k;
+        }
+        row[largest] += (int16_t)((1 << COEFF_BITS) - total);
+
+        if (i >= period && std::equal(row.begin(), row.end(), axis.coeffs.begin() + axis.offset[i - period]))
+        {
+            axis.offset[i] = axis.offset[i - period];
+            continue;
+        }
+        axis.offset[i] = (uint32_t)axis.coeffs.size();
+        axis.coeffs.insert(axis.coeffs.end(), row.begin(), row.end());
+    }
+}
+
+// 8-bit <-> 14-bit conversions. sRGB goes through linear light like stbir's _SRGB type, every
+// 14-bit value maps back to the correctly rounded nearest 8-bit level; plain values are shifted.
+struct FixedTables
+{
+    uint16_t from_srgb[256];
+    uint16_t from_plain[256];
+    uint8_t to_srgb[VALUE_MAX + 1];
+    uint8_t to_plain[VALUE_MAX + 1];
+
+    FixedTables()
+    {
+        for (int v = 0; v < 256; ++v)
+        {
+            const double c = v / 255.0;
+            const double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            from_srgb[v] = (uint16_t)std::lround(linear * VALUE_MAX);
+            from_plain[v] = (uint16_t)(v << PLAIN_SHIFT);
+        }
+        for (int x = 0; x <= VALUE_MAX; ++x)
+        {
+            const double linear = (double)x / VALUE_MAX;
+            const double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1 / 2.4) - 0.055;
+            to_srgb[x] = (uint8_t)std::lround(std::clamp(c, 0.0, 1.0) * 255);
+            to_plain[x] = (uint8_t)std::min(255, (x + (1 << (PLAIN_SHIFT - 1))) >> PLAIN_SHIFT);
+        }
+    }
+};
+
+static const FixedTables &fixed_tables()
+{
+    static const FixedTables tables;
+    return tables;
+}
+
+static inline int16_t clamp_int16(int value)
+{
+    return (int16_t)std::clamp(value, -32768, 32767);
+}
+
+// One input row to 14-bit values, RGB in the pair layout (the zero lanes are never written)
+static void widen_row(const unsigned char *in, int width, int channels, const uint16_t *table, uint16_t *dst)
+{
+    if (channels == 1)
+    {
+        for (int x = 0; x < width; ++x)
+            dst[x] = table[in[x]];
+        return;
+    }
+    int x = 0;
+    for (; x + 1 < width; x += 2, in += 6)
+    {
+        uint16_t *pair = dst + x * RGB_LANES;
+        pair[0] = table[in[0]];
+        pair[1] = table[in[3]];
+        pair[2] = table[in[1]];
+        pair[3] = table[in[4]];
+        pair[4] = table[in[2]];
+        pair[5] = table[in[5]];
+    }
+    if (x < width)
+    {
+        uint16_t *pair = dst + x * RGB_LANES;
+        pair[0] = table[in[0]];
+        pair[2] = table[in[1]];
+        pair[4] = table[in[2]];
+    }
+}
+
+// One output row back to 8 bits, dropping the RGB zero lane
+static void narrow_row(const int16_t *src, int width, int channels, const uint8_t *table, unsigned char *out)
+{
+    if (channels == 1)
+    {
+        for (int x = 0; x < width; ++x)
+            out[x] = table[std::clamp((int)src[x], 0, VALUE_MAX)];
+        return;
+    }
+    for (int x = 0; x < width; ++x, src += RGB_LANES, out += 3)
+    {
+        out[0] = table[std::clamp((int)src[0], 0, VALUE_MAX)];
+        out[1] = table[std::clamp((int)src[1], 0, VALUE_MAX)];
+        out[2] = table[std::clamp((int)src[2], 0, VALUE_MAX)];
+    }
+}
+
+#ifndef FIXED_RESIZE_SSE2
+// plain C kernels for targets without SSE2, the SIMD versions below compute exactly the same sums
+static void horizontal_scalar(const uint16_t *src, const FixedAxis &axis, int lanes, int16_t *dst)
+{
+    const int output_size = (int)axis.first.size();
+    for (int i = 0; i < output_size; ++i)
+    {
+        const uint16_t *pixels = src + (size_t)axis.first[i] * lanes;
+        const int16_t *coeffs = axis.weights(i);
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            int sum = COEFF_ROUND;
+            for (int k = 0; k < axis.count[i]; ++k)
+                sum += (lanes == 1 ? pixels[k] : pixels[k / 2 * 8 + lane * 2 + k % 2]) * coeffs[k];
+            dst[i * lanes + lane] = clamp_int16(sum >> COEFF_BITS);
+        }
+    }
+}
+
+static void vertical_scalar(const int16_t *const *rows, const int16_t *coeffs, int count, int length, int16_t *dst)
+{
+    for (int x = 0; x < length; ++x)
+    {
+        int sum = COEFF_ROUND;
+        for (int k = 0; k < count; ++k)
+            sum += rows[k][x] * coeffs[k];
+        dst[x] = clamp_int16(sum >> COEFF_BITS);
+    }
+}
+#else
+// One pixel pair per pmaddwd against the (c_k, c_k+1) weight pair gives the lane sums of two taps
+static void horizontal_rgb_sse2(const uint16_t *src, const FixedAxis &axis, int16_t *dst)
+{
+    const int output_size = (int)axis.first.size();
+    const __m128i round = _mm_set1_epi32(COEFF_ROUND);
+    for (int i = 0; i < output_size; ++i)
+    {
+        const uint16_t *pixels = src + (size_t)axis.first[i] * RGB_LANES;
+        const int16_t *coeffs = axis.weights(i);
+        __m128i sum = round;
+        for (int k = 0; k < axis.count[i]; k += 2)
+        {
+            int pair;
+            std::memcpy(&pair, coeffs + k, sizeof(pair));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(pixels + k * RGB_LANES)),
+                                                     _mm_set1_epi32(pair)));
+        }
+        sum = _mm_srai_epi32(sum, COEFF_BITS);
+        _mm_storel_epi64((__m128i *)(dst + i * RGB_LANES), _mm_packs_epi32(sum, sum));
+    }
+}
+
+static inline int horizontal_sum(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static void horizontal_gray_sse2(const uint16_t *src, const FixedAxis &axis, int16_t *dst)
+{
+    const int output_size = (int)axis.first.size();
+    for (int i = 0; i < output_size; ++i)
+    {
+        const uint16_t *pixels = src + axis.first[i];
+        const int16_t *coeffs = axis.weights(i);
+        __m128i sum = _mm_setzero_si128();
+        for (int k = 0; k < axis.count[i]; k += 8)
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(pixels + k)),
+                                                     _mm_loadu_si128((const __m128i *)(coeffs + k))));
+        dst[i] = clamp_int16((horizontal_sum(sum) + COEFF_ROUND) >> COEFF_BITS);
+    }
+}
+
+// Rows k and k+1 interleaved, pmaddwd against (c_k, c_k+1); an odd last tap pairs with itself at weight 0
+static void vertical_sse2(const int16_t *const *rows, const int16_t *coeffs, int count, int length, int16_t *dst)
+{
+    const __m128i round = _mm_set1_epi32(COEFF_ROUND);
+    for (int x = 0; x < length; x += 8)
+    {
+        __m128i low = round, high = round;
+        for (int k = 0; k < count; k += 2)
+        {
+            const bool odd = k + 1 == count;
+            const __m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + x));
+            const __m128i b = _mm_loadu_si128((const __m128i *)(rows[odd ? k : k + 1] + x));
+            const __m128i pair = _mm_set1_epi32((uint16_t)coeffs[k] | (odd ? 0 : (int)coeffs[k + 1] << 16));
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), pair));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), pair));
+        }
+        _mm_storeu_si128((__m128i *)(dst + x),
+                         _mm_packs_epi32(_mm_srai_epi32(low, COEFF_BITS), _mm_srai_epi32(high, COEFF_BITS)));
+    }
+}
+#endif
+
+#ifdef FIXED_RESIZE_AVX2
+// The same kernels twice as wide. Unpack and pack work within 128-bit halves, which keeps the
+// pixel order intact; the RGB kernel spreads two weight pairs over the halves for two pixel pairs.
+__attribute__((target("avx2"))) static void horizontal_rgb_avx2(const uint16_t *src, const FixedAxis &axis, int16_t *dst)
+{
+    const int output_size = (int)axis.first.size();
+    const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    for (int i = 0; i < output_size; ++i)
+    {
+        const uint16_t *pixels = src + (size_t)axis.first[i] * RGB_LANES;
+        const int16_t *coeffs = axis.weights(i);
+        __m256i sum = _mm256_setzero_si256();
+        for (int k = 0; k < axis.count[i]; k += 4)
+        {
+            const __m256i weights = _mm256_permutevar8x32_epi32(
+                _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)(coeffs + k))), spread);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(pixels + k * RGB_LANES)),
+                                                           weights));
+        }
+        __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        total = _mm_srai_epi32(_mm_add_epi32(total, _mm_set1_epi32(COEFF_ROUND)), COEFF_BITS);
+        _mm_storel_epi64((__m128i *)(dst + i * RGB_LANES), _mm_packs_epi32(total, total));
+    }
+}
+
+__attribute__((target("avx2"))) static void horizontal_gray_avx2(const uint16_t *src, const FixedAxis &axis, int16_t *dst)
+{
+    const int output_size = (int)axis.first.size();
+    for (int i = 0; i < output_size; ++i)
+    {
+        const uint16_t *pixels = src + axis.first[i];
+        const int16_t *coeffs = axis.weights(i);
+        __m256i sum = _mm256_setzero_si256();
+        for (int k = 0; k < axis.count[i]; k += 16)
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(pixels + k)),
+                                                           _mm256_loadu_si256((const __m256i *)(coeffs + k))));
+        const __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        dst[i] = clamp_int16((horizontal_sum(total) + COEFF_ROUND) >> COEFF_BITS);
+    }
+}
+
+__attribute__((target("avx2"))) static void vertical_avx2(const int16_t *const *rows, const int16_t *coeffs, int count,
+                                                          int length, int16_t *dst)
+{
+    const __m256i round = _mm256_set1_epi32(COEFF_ROUND);
+    for (int x = 0; x < length; x += 16)
+    {
+        __m256i low = round, high = round;
+        for (int k = 0; k < count; k += 2)
+        {
+            const bool odd = k + 1 == count;
+            const __m256i a = _mm256_loadu_si256((const __m256i *)(rows[k] + x));
+            const __m256i b = _mm256_loadu_si256((const __m256i *)(rows[odd ? k : k + 1] + x));
+            const __m256i pair = _mm256_set1_epi32((uint16_t)coeffs[k] | (odd ? 0 : (int)coeffs[k + 1] << 16));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), pair));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), pair));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + x),
+                            _mm256_packs_epi32(_mm256_srai_epi32(low, COEFF_BITS), _mm256_srai_epi32(high, COEFF_BITS)));
+    }
+}
+
+// --colorspace linear rows without the table: bytes are put in pair order with pshufb (RGB),
+// zero extended and shifted, 16 values per store
+__attribute__((target("avx2"))) static void widen_plain_avx2(const unsigned char *in, int width, int channels, uint16_t *dst)
+{
+    int x = 0;
+    if (channels == 1)
+    {
+        for (; x + 16 <= width; x += 16)
+            _mm256_storeu_si256((__m256i *)(dst + x),
+                                _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(in + x))), PLAIN_SHIFT));
+        for (; x < width; ++x)
+            dst[x] = (uint16_t)(in[x] << PLAIN_SHIFT);
+        return;
+    }
+
+    // four pixels (two pairs) per step; the 16-byte load needs 4 bytes past them
+    const __m128i order = _mm_setr_epi8(0, 3, 1, 4, 2, 5, -1, -1, 6, 9, 7, 10, 8, 11, -1, -1);
+    for (; x + 6 <= width; x += 4)
+    {
+        const __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + x * 3)), order);
+        _mm256_storeu_si256((__m256i *)(dst + x * RGB_LANES), _mm256_slli_epi16(_mm256_cvtepu8_epi16(bytes), PLAIN_SHIFT));
+    }
+    widen_row(in + x * 3, width - x, channels, fixed_tables().from_plain, dst + x * RGB_LANES);
+}
+
+// And back: round, shift and saturate to bytes, RGB drops its zero lane with pshufb
+__attribute__((target("avx2"))) static void narrow_plain_avx2(const int16_t *src, int width, int channels, unsigned char *out)
+{
+    const __m128i round = _mm_set1_epi16(1 << (PLAIN_SHIFT - 1));
+    int x = 0;
+    if (channels == 1)
+    {
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i a = _mm_srai_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)(src + x)), round), PLAIN_SHIFT);
+            const __m128i b = _mm_srai_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)(src + x + 8)), round), PLAIN_SHIFT);
+            _mm_storeu_si128((__m128i *)(out + x), _mm_packus_epi16(a, b));
+        }
+        narrow_row(src + x, width - x, channels, fixed_tables().to_plain, out + x);
+        return;
+    }
+
+    // four pixels per step, the 16-byte store runs 4 bytes into the next pixels, which are written after
+    const __m128i order = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (; x + 6 <= width; x += 4)
+    {
+        const int16_t *pixels = src + x * RGB_LANES;
+        const __m128i a = _mm_srai_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)pixels), round), PLAIN_SHIFT);
+        const __m128i b = _mm_srai_epi16(_mm_add_epi16(_mm_loadu_si128((const __m128i *)(pixels + 8)), round), PLAIN_SHIFT);
+        _mm_storeu_si128((__m128i *)(out + x * 3), _mm_shuffle_epi8(_mm_packus_epi16(a, b), order));
+    }
+    narrow_row(src + x * RGB_LANES, width - x, channels, fixed_tables().to_plain, out + x * 3);
+}
+
+static bool cpu_has_avx2()
+{
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+#endif
+
+static void widen_pass(const unsigned char *in, int width, int channels, bool srgb, uint16_t *dst)
+{
+#ifdef FIXED_RESIZE_AVX2
+    if (!srgb && cpu_has_avx2())
+    {
+        widen_plain_avx2(in, width, channels, dst);
+        return;
+    }
+#endif
+    const FixedTables &tables = fixed_tables();
+    widen_row(in, width, channels, srgb ? tables.from_srgb : tables.from_plain, dst);
+}
+
+static void narrow_pass(const int16_t *src, int width, int channels, bool srgb, unsigned char *out)
+{
+#ifdef FIXED_RESIZE_AVX2
+    if (!srgb && cpu_has_avx2())
+    {
+        narrow_plain_avx2(src, width, channels, out);
+        return;
+    }
+#endif
+    const FixedTables &tables = fixed_tables();
+    narrow_row(src, width, channels, srgb ? tables.to_srgb : tables.to_plain, out);
+}
+
+static void horizontal_pass(const uint16_t *src, const FixedAxis &axis, int lanes, int16_t *dst)
+{
+#ifdef FIXED_RESIZE_AVX2
+    if (cpu_has_avx2())
+    {
+        if (lanes == 1)
+            horizontal_gray_avx2(src, axis, dst);
+        else
+            horizontal_rgb_avx2(src, axis, dst);
+        return;
+    }
+#endif
+#ifdef FIXED_RESIZE_SSE2
+    if (lanes == 1)
+        horizontal_gray_sse2(src, axis, dst);
+    else
+        horizontal_rgb_sse2(src, axis, dst);
+#else
+    horizontal_scalar(src, axis, lanes, dst);
+#endif
+}
+
+// length must be a multiple of 16, the rows are padded to that
+static void vertical_pass(const int16_t *const *rows, const int16_t *coeffs, int count, int length, int16_t *dst)
+{
+#ifdef FIXED_RESIZE_AVX2
+    if (cpu_has_avx2())
+    {
+        vertical_avx2(rows, coeffs, count, length, dst);
+        return;
+    }
+#endif
+#ifdef FIXED_RESIZE_SSE2
+    vertical_sse2(rows, coeffs, count, length, dst);
+#else
+    vertical_scalar(rows, coeffs, count, length, dst);
+#endif
+}
+
+// Per-thread coefficients of the last geometry, like the stbir sampler cache in image_processor.cpp
+struct FixedSampler
+{
+    bool valid = false;
+    int input_w = 0, input_h = 0, output_w = 0, output_h = 0, lanes = 0;
+    ResizeFilter filter = FILTER_DEFAULT;
+    FixedAxis horizontal;
+    FixedAxis vertical;
+};
+
+static thread_local FixedSampler fixed_sampler;
+
+bool FixedResizeSupports(int channels, ResizeFilter filter)
+{
+    return (channels == 1 || channels == 3) && filter != FILTER_POINT;
+}
+
+unsigned char *FixedResize(const unsigned char *input_pixels, int input_w, int input_h, int channels,
+                           int output_w, int output_h, ResizeFilter filter, bool srgb)
+{
+    if (!FixedResizeSupports(channels, filter) || input_w <= 0 || input_h <= 0 || output_w <= 0 || output_h <= 0)
+        return nullptr;
+    const int lanes = channels == 1 ? 1 : RGB_LANES;
+
+    FixedSampler &sampler = fixed_sampler;
+    if (!sampler.valid || sampler.input_w != input_w || sampler.input_h != input_h || sampler.output_w != output_w ||
+        sampler.output_h != output_h || sampler.lanes != lanes || sampler.filter != filter)
+    {
+        build_axis(sampler.horizontal, input_w, output_w, filter, lanes == 1 ? GRAY_TAP_MULTIPLE : RGB_TAP_MULTIPLE,
+                   lanes != 1);
+        build_axis(sampler.vertical, input_h, output_h, filter, 1, false);
+        sampler.valid = true;
+        sampler.input_w = input_w;
+        sampler.input_h = input_h;
+        sampler.output_w = output_w;
+        sampler.output_h = output_h;
+        sampler.lanes = lanes;
+        sampler.filter = filter;
+    }
+    const FixedAxis &horizontal = sampler.horizontal;
+    const FixedAxis &vertical = sampler.vertical;
+
+    // one input row widened to 14-bit lanes (padded so the last taps can over-read zeros), a ring of
+    // horizontally filtered rows deep enough for one output row's taps, and one vertical result
+    const size_t source_length = (size_t)(input_w + horizontal.width + 1) * lanes;
+    const int row_length = (output_w * lanes + 15) / 16 * 16;
+    const int ring_rows = vertical.max_count;
+    const size_t work_bytes = source_length * sizeof(uint16_t) + ((size_t)ring_rows + 1) * row_length * sizeof(int16_t);
+
+    unsigned char *output_pixels = (unsigned char *)AllocTrackedMalloc((size_t)output_w * output_h * channels);
+    unsigned char *work = (unsigned char *)AllocTrackedMalloc(work_bytes);
+    if (output_pixels == nullptr || work == nullptr)
+    {
+        AllocTrackedFree(output_pixels);
+        AllocTrackedFree(work);
+        return nullptr;
+    }
+    std::memset(work, 0, work_bytes);
+    uint16_t *source = (uint16_t *)work;
+    int16_t *ring = (int16_t *)(work + source_length * sizeof(uint16_t));
+    int16_t *result = ring + (size_t)ring_rows * row_length;
+
+    std::vector<int> ring_source(ring_rows, -1); // input row held by each ring slot
+    std::vector<const int16_t *> taps(ring_rows);
+    for (int y = 0; y < output_h; ++y)
+    {
+        const int first = vertical.first[y];
+        const int count = vertical.count[y];
+        for (int k = 0; k < count; ++k)
+        {
+            const int row = first + k;
+            const int slot = row % ring_rows;
+            int16_t *filtered = ring + (size_t)slot * row_length;
+            if (ring_source[slot] != row)
+            {
+                widen_pass(input_pixels + (size_t)row * input_w * channels, input_w, channels, srgb, source);
+                horizontal_pass(source, horizontal, lanes, filtered);
+                ring_source[slot] = row;
+            }
+            taps[k] = filtered;
+        }
+
+        vertical_pass(taps.data(), vertical.weights(y), count, row_length, result);
+
+        narrow_pass(result, output_w, channels, srgb, output_pixels + (size_t)y * output_w * channels);
+    }
+
+    AllocTrackedFree(work);
+    return output_pixels;
+}
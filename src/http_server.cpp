@@ -0,0 +1,495 @@
+#include "http_server.h"
+#include <iostream>
+
+#ifdef _WIN32
+
+int RunHttpServer(int port, const std::string &root_dir, unsigned int threads, size_t cache_bytes, const ResizeOptions &defaults)
+{
+    std::cout << "Error: --http is not supported on Windows." << std::endl;
+    return 1;
+}
+
+#else
+
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#endif
+#include "blocking_queue.h"
+#include "file_helpers.h"
+#include "latency_recorder.h"
+#include "net_helpers.h"
+#include "tar_stream.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+static volatile std::sig_atomic_t http_stop_requested = 0;
+
+static void handle_http_stop_signal(int)
+{
+    http_stop_requested = 1;
+}
+
+#ifdef __linux__
+static bool write_all_fd(int fd, const unsigned char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+#endif
+
+#ifdef __linux__
+// Only large bodies get a memfd, and only this many at once: a cache full of small thumbnails
+// would otherwise hold an fd per entry and run the process out of them (accept, source reads)
+static const size_t MEMFD_MIN_BYTES = 256 * 1024;
+static const int MAX_MEMFD_RESULTS = 256;
+static std::atomic<int> memfd_results{0};
+#endif
+
+// One encoded result. On Linux large bodies sit in a memfd so hits can be sendfile()d,
+// everything else is kept as a plain byte buffer.
+struct CachedResult
+{
+    string content_type;
+    size_t size = 0;
+#ifdef __linux__
+    int fd = -1;
+#endif
+    std::vector<unsigned char> bytes;
+
+    ~CachedResult()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            ::close(fd);
+            memfd_results--;
+        }
+#endif
+    }
+};
+
+static std::shared_ptr<CachedResult> make_cached_result(std::vector<unsigned char> &&bytes, const string &content_type)
+{
+    auto result = std::make_shared<CachedResult>();
+    result->content_type = content_type;
+    result->size = bytes.size();
+#ifdef __linux__
+    if (bytes.size() >= MEMFD_MIN_BYTES)
+    {
+        // the slot is taken before the memfd exists so concurrent misses can't overshoot the limit
+        if (memfd_results++ < MAX_MEMFD_RESULTS)
+        {
+            int fd = ::memfd_create("imagecompress-result", MFD_CLOEXEC);
+            if (fd >= 0 && write_all_fd(fd, bytes.data(), bytes.size()))
+            {
+                result->fd = fd;
+                return result;
+            }
+            if (fd >= 0)
+                ::close(fd);
+        }
+        memfd_results--;
+    }
+#endif
+    result->bytes = std::move(bytes);
+    return result;
+}
+
+// Byte-bounded LRU keyed by the normalized request
+class ResultCache
+{
+public:
+    explicit ResultCache(size_t capacity_bytes) : capacity_(capacity_bytes) {}
+
+    std::shared_ptr<CachedResult> get(const string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end())
+            return nullptr;
+        order_.splice(order_.begin(), order_, it->second);
+        return it->second->second;
+    }
+
+    void put(const string &key, std::shared_ptr<CachedResult> value)
+    {
+        if (value->size > capacity_)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it != index_.end())
+        {
+            used_ -= it->second->second->size;
+            order_.erase(it->second);
+            index_.erase(it);
+        }
+
+        order_.emplace_front(key, value);
+        index_[key] = order_.begin();
+        used_ += value->size;
+
+        while (used_ > capacity_ && !order_.empty())
+        {
+            // in-flight hits keep their shared_ptr, the memfd closes when the last one lets go
+            used_ -= order_.back().second->size;
+            index_.erase(order_.back().first);
+            order_.pop_back();
+        }
+    }
+
+    size_t used() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return used_;
+    }
+
+    size_t entries() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index_.size();
+    }
+
+private:
+    using Entry = std::pair<string, std::shared_ptr<CachedResult>>;
+
+    mutable std::mutex mutex_;
+    std::list<Entry> order_;
+    std::unordered_map<string, std::list<Entry>::iterator> index_;
+    size_t capacity_;
+    size_t used_ = 0;
+};
+
+static bool send_response_head(int fd, int status, const char *reason, const string &content_type,
+                               size_t length, bool keep_alive, const string &extra_headers)
+{
+    string head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n" +
+                  "Content-Type: " + content_type + "\r\n" +
+                  "Content-Length: " + std::to_string(length) + "\r\n" +
+                  (keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n") +
+                  extra_headers + "\r\n";
+    return SendAll(fd, head.data(), head.size());
+}
+
+static bool send_text(int fd, int status, const char *reason, const string &body, bool keep_alive)
+{
+    return send_response_head(fd, status, reason, "text/plain", body.size(), keep_alive, "") &&
+           SendAll(fd, body.data(), body.size());
+}
+
+static bool send_cached(int fd, const CachedResult &result, bool head_only, bool keep_alive, const char *cache_state)
+{
+    if (!send_response_head(fd, 200, "OK", result.content_type, result.size, keep_alive,
+                            string("X-Cache: ") + cache_state + "\r\n"))
+        return false;
+    if (head_only)
+        return true;
+
+#ifdef __linux__
+    if (result.fd >= 0)
+    {
+        off_t offset = 0;
+        while ((size_t)offset < result.size)
+        {
+            ssize_t sent = ::sendfile(fd, result.fd, &offset, result.size - (size_t)offset);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+        }
+        return true;
+    }
+#endif
+    return SendAll(fd, result.bytes.data(), result.bytes.size());
+}
+
+int RunHttpServer(int port, const std::string &root_dir, unsigned int threads, size_t cache_bytes, const ResizeOptions &defaults)
+{
+    if (threads == 0)
+        threads = 1;
+
+    int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // never exposed beyond localhost
+
+    if (listen_fd < 0 || ::bind(listen_fd, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(listen_fd, 256) != 0)
+    {
+        cout << "Error: Could not listen on 127.0.0.1:" << port << ": " << std::strerror(errno) << endl;
+        if (listen_fd >= 0)
+            ::close(listen_fd);
+        return 1;
+    }
+
+    std::signal(SIGINT, handle_http_stop_signal);
+    std::signal(SIGTERM, handle_http_stop_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    ResultCache cache(cache_bytes);
+    LatencyRecorder latency;
+    std::atomic<unsigned long long> hits{0}, misses{0}, errors{0};
+    BlockingQueue<int> connections(threads * 16);
+
+    // Returns false when the connection should be closed
+    auto handle_request = [&](int fd, SocketReader &reader) -> bool
+    {
+        string request_line;
+        if (!reader.read_line(request_line, 8192))
+            return false;
+
+        const auto start = std::chrono::steady_clock::now();
+
+        // METHOD SP target SP version
+        const size_t first_space = request_line.find(' ');
+        const size_t second_space = request_line.find(' ', first_space + 1);
+        if (first_space == string::npos || second_space == string::npos)
+        {
+            send_text(fd, 400, "Bad Request", "malformed request line\n", false);
+            return false;
+        }
+        const string method = request_line.substr(0, first_space);
+        const string target = request_line.substr(first_space + 1, second_space - first_space - 1);
+        const string version = request_line.substr(second_space + 1);
+
+        bool keep_alive = version == "HTTP/1.1";
+        string header;
+        while (true)
+        {
+            if (!reader.read_line(header, 8192))
+                return false;
+            if (header.empty())
+                break;
+
+            string lower = header;
+            for (char &c : lower)
+                c = (char)std::tolower((unsigned char)c);
+            if (lower.rfind("connection:", 0) == 0)
+            {
+                if (lower.find("close") != string::npos)
+                    keep_alive = false;
+                else if (lower.find("keep-alive") != string::npos)
+                    keep_alive = true;
+            }
+        }
+
+        if (method != "GET" && method != "HEAD")
+            return send_text(fd, 405, "Method Not Allowed", "only GET and HEAD are supported\n", keep_alive) && keep_alive;
+        const bool head_only = method == "HEAD";
+
+        const size_t question = target.find('?');
+        const string path = target.substr(0, question);
+        const auto query = ParseKeyValues(question == string::npos ? string() : target.substr(question + 1), '&');
+        auto get = [&query](const char *key) -> string
+        {
+            auto it = query.find(key);
+            return it == query.end() ? string() : it->second;
+        };
+
+        if (path == "/stats")
+        {
+            const string body = "requests " + latency.format() + "\n" +
+                                "cache hits=" + std::to_string(hits.load()) + " misses=" + std::to_string(misses.load()) +
+                                " entries=" + std::to_string(cache.entries()) + " bytes=" + std::to_string(cache.used()) + "\n" +
+                                "errors " + std::to_string(errors.load()) + "\n";
+            return send_text(fd, 200, "OK", body, keep_alive) && keep_alive;
+        }
+        if (path != "/resize")
+            return send_text(fd, 404, "Not Found", "unknown path\n", keep_alive) && keep_alive;
+
+        ResizeOptions options = defaults;
+        int width = 0, height = 0, size = 0;
+        try
+        {
+            if (!get("w").empty())
+                width = std::stoi(get("w"));
+            if (!get("h").empty())
+                height = std::stoi(get("h"));
+            if (!get("size").empty())
+                size = std::stoi(get("size"));
+            if (!get("q").empty())
+                options.quality = std::stoi(get("q"));
+        }
+        catch (const std::exception &)
+        {
+            errors++;
+            return send_text(fd, 400, "Bad Request", "invalid numeric parameter\n", keep_alive) && keep_alive;
+        }
+        if (width < 0 || height < 0 || (!get("size").empty() && size <= 0) || options.quality < 1 || options.quality > 100)
+        {
+            errors++;
+            return send_text(fd, 400, "Bad Request", "parameter out of range\n", keep_alive) && keep_alive;
+        }
+        if (!SetResizeGeometry(options, width, height, size))
+        {
+            errors++;
+            return send_text(fd, 400, "Bad Request", "only one of w, h or size may be given\n", keep_alive) && keep_alive;
+        }
+
+        // src must stay inside the served root
+        const string relative = SafeMemberPath(get("src"));
+        if (relative.empty())
+        {
+            errors++;
+            return send_text(fd, 400, "Bad Request", "missing or invalid src\n", keep_alive) && keep_alive;
+        }
+        const string source = (std::filesystem::path(root_dir) / relative).string();
+
+        string extension = std::filesystem::path(relative).extension().string();
+        if (get("format") == "png")
+            extension = ".png";
+        else if (get("format") == "jpg" || get("format") == "jpeg")
+            extension = ".jpg";
+        if (extension != ".png" && extension != ".jpg" && extension != ".jpeg")
+        {
+            errors++;
+            return send_text(fd, 400, "Bad Request", "unsupported format\n", keep_alive) && keep_alive;
+        }
+        const string content_type = extension == ".png" ? "image/png" : "image/jpeg";
+
+        // the source's mtime and size are part of the key, so an edited or replaced original is resized again
+        std::error_code error;
+        const auto source_size = std::filesystem::file_size(source, error);
+        const auto source_time = error ? std::filesystem::file_time_type() : std::filesystem::last_write_time(source, error);
+        if (error)
+        {
+            errors++;
+            return send_text(fd, 404, "Not Found", "source not found\n", keep_alive) && keep_alive;
+        }
+
+        const string key = relative + "|" + std::to_string(source_size) + "|" + std::to_string(source_time.time_since_epoch().count()) + "|" +
+                           std::to_string(options.width) + "|" + std::to_string(options.height) + "|" +
+                           std::to_string(options.size) + "|" + std::to_string(options.quality) + "|" + extension;
+
+        std::shared_ptr<CachedResult> result = cache.get(key);
+        const char *cache_state = "HIT";
+        if (result)
+            hits++;
+        else
+        {
+            misses++;
+            cache_state = "MISS";
+
+            std::vector<unsigned char> input;
+            if (!ReadFileBytes(source, input))
+            {
+                errors++;
+                return send_text(fd, 500, "Internal Server Error", "cannot read source\n", keep_alive) && keep_alive;
+            }
+
+            std::vector<unsigned char> encoded;
+            if (!ResizeImageBuffer(input.data(), input.size(), extension, options, encoded, source))
+            {
+                errors++;
+                return send_text(fd, 500, "Internal Server Error", "failed to process image\n", keep_alive) && keep_alive;
+            }
+
+            result = make_cached_result(std::move(encoded), content_type);
+            cache.put(key, result);
+        }
+
+        const bool sent = send_cached(fd, *result, head_only, keep_alive, cache_state);
+        latency.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        return sent && keep_alive;
+    };
+
+    // Fixed pool of handler threads, each owns one connection at a time and does the resize itself
+    std::vector<std::thread> handlers;
+    handlers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+        handlers.emplace_back([&]()
+        {
+            int fd;
+            while (connections.pop(fd))
+            {
+                // idle keep-alive connections give their handler back after a few seconds
+                timeval timeout = {5, 0};
+                ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                int nodelay = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+                SocketReader reader(fd);
+                try
+                {
+                    while (!http_stop_requested && handle_request(fd, reader))
+                    {
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    cout << "Exception while serving request: " << e.what() << endl;
+                }
+                ::close(fd);
+            }
+        });
+    }
+
+    cout << "Serving http://127.0.0.1:" << port << "/resize from " << root_dir << " with " << threads
+         << " threads, cache " << cache_bytes / (1024 * 1024) << " MB (Ctrl+C to stop)" << endl;
+
+    while (!http_stop_requested)
+    {
+        pollfd waiting = {listen_fd, POLLIN, 0};
+        if (::poll(&waiting, 1, 200) <= 0)
+            continue;
+
+        int client_fd = ::accept(listen_fd, nullptr, nullptr);
+        if (client_fd >= 0)
+            connections.push(client_fd);
+        else if (errno == EMFILE || errno == ENFILE)
+        {
+            // the connection stays queued and poll keeps reporting it, so back off instead of spinning
+            cout << "Error: accept failed: " << std::strerror(errno) << ", retrying in 100 ms" << endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        else if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED)
+            cout << "Error: accept failed: " << std::strerror(errno) << endl;
+    }
+
+    cout << "Stopping server ..." << endl;
+    ::close(listen_fd);
+    connections.close();
+    for (std::thread &handler : handlers)
+        handler.join();
+
+    cout << "Requests: " << latency.format() << " hits=" << hits.load() << " misses=" << misses.load()
+         << " errors=" << errors.load() << endl;
+    return 0;
+}
+
+#endif
@@ -1,5 +1,17 @@
 // --- STB Implementation ---
 // This is the ONE place this block lives
+#include "alloc_tracker.h"
+
+// all stb heap traffic goes through the tracker so per-image peak memory can be reported
+#define STBI_MALLOC(sz) AllocTrackedMalloc(sz)
+#define STBI_REALLOC(p, newsz) AllocTrackedRealloc(p, newsz)
+#define STBI_FREE(p) AllocTrackedFree(p)
+#define STBIW_MALLOC(sz) AllocTrackedMalloc(sz)
+#define STBIW_REALLOC(p, newsz) AllocTrackedRealloc(p, newsz)
+#define STBIW_FREE(p) AllocTrackedFree(p)
+#define STBIR_MALLOC(size, user_data) ((void)(user_data), AllocTrackedMalloc(size))
+#define STBIR_FREE(ptr, user_data) ((void)(user_data), AllocTrackedFree(ptr))
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -11,6 +23,12 @@
 // --- End STB Implementation ---
 
 #include "image_processor.h"
+#include "file_helpers.h"
+#include "fixed_resize.h"
+#include "result_cache.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 
@@ -18,93 +36,976 @@ using std::cout;
 using std::endl;
 using std::string;
 
-void ResizeImage(const std::string &filepath,
-                 const std::string &_outdir,
-                 int _size,
-                 int _quality,
-                 int _width,
-                 int _height)
+// stbi_write_*_to_func callback, appends the encoded bytes to a std::vector
+static void append_to_vector(void *context, void *data, int size)
 {
-    try
+    auto *bytes = static_cast<std::vector<unsigned char> *>(context);
+    const unsigned char *begin = static_cast<const unsigned char *>(data);
+    bytes->insert(bytes->end(), begin, begin + size);
+}
+
+// Per-thread cache of the last built stbir samplers. Batch workers and the long-running serve
+// modes see the same geometry over and over, so the filter coefficients are built once and
+// only the buffer pointers change between images.
+struct ResamplerCache
+{
+    STBIR_RESIZE resize;
+    bool valid = false;
+    int input_w = 0, input_h = 0, output_w = 0, output_h = 0;
+    stbir_pixel_layout layout = STBIR_RGB;
+    bool fast_alpha = false;
+    ResizeFilter filter = FILTER_DEFAULT;
+    bool srgb = true;
+    double input_s1 = 1.0, input_t1 = 1.0;
+
+    bool matches(int in_w, int in_h, int out_w, int out_h, stbir_pixel_layout pixel_layout, const ResizeOptions &options,
+                 double s1, double t1) const
+    {
+        return valid && input_w == in_w && input_h == in_h && output_w == out_w && output_h == out_h &&
+               layout == pixel_layout && fast_alpha == options.fast_alpha && filter == options.filter && srgb == options.srgb &&
+               input_s1 == s1 && input_t1 == t1;
+    }
+
+    ~ResamplerCache()
     {
-        int orig_width, orig_height, channels;
-        unsigned char *input_pixels = stbi_load(filepath.c_str(), &orig_width, &orig_height, &channels, 0);
+        if (valid)
+            stbir_free_samplers(&resize);
+    }
+};
+
+// Two entries, the --jpeg-planar path alternates between the luma and the chroma geometry
+static thread_local ResamplerCache resampler_cache[2];
+static thread_local int resampler_cache_last = 0;
+
+static_assert((int)FILTER_POINT == (int)STBIR_FILTER_POINT_SAMPLE, "ResizeFilter must mirror stbir_filter");
+
+// stbir_resize_uint8_srgb with the --filter/--colorspace/--fast-alpha settings, reusing this
+// thread's samplers when the geometry and settings repeat. input_s1/input_t1 below 1 map only that
+// fraction of the input (from the top left) onto the output.
+static unsigned char *resize_pixels(const unsigned char *input_pixels, int input_w, int input_h,
+                                    int output_w, int output_h, stbir_pixel_layout layout, int channels,
+                                    const ResizeOptions &options, double input_s1 = 1.0, double input_t1 = 1.0)
+{
+    if (output_w <= 0 || output_h <= 0)
+        return nullptr;
 
-        if (input_pixels == nullptr)
+    unsigned char *output_pixels = (unsigned char *)STBIR_MALLOC((size_t)output_w * output_h * channels, NULL);
+    if (output_pixels == nullptr)
+        return nullptr;
+
+    // reuse a matching entry, else replace the one not used last
+    int slot = 1 - resampler_cache_last;
+    if (resampler_cache[resampler_cache_last].matches(input_w, input_h, output_w, output_h, layout, options, input_s1, input_t1))
+        slot = resampler_cache_last;
+    resampler_cache_last = slot;
+    ResamplerCache &cache = resampler_cache[slot];
+    if (!cache.matches(input_w, input_h, output_w, output_h, layout, options, input_s1, input_t1))
+    {
+        if (cache.valid)
+            stbir_free_samplers(&cache.resize);
+        cache.valid = false;
+
+        stbir_resize_init(&cache.resize, input_pixels, input_w, input_h, 0, output_pixels, output_w, output_h, 0,
+                          layout, options.srgb ? STBIR_TYPE_UINT8_SRGB : STBIR_TYPE_UINT8);
+        if (options.filter != FILTER_DEFAULT)
+            stbir_set_filters(&cache.resize, (stbir_filter)options.filter, (stbir_filter)options.filter);
+        // --fast-alpha: skip the extra work that keeps colour under fully transparent pixels sensible
+        if (options.fast_alpha)
+            stbir_set_non_pm_alpha_speed_over_quality(&cache.resize, 1);
+        if (input_s1 < 1.0 || input_t1 < 1.0)
+            stbir_set_input_subrect(&cache.resize, 0.0, 0.0, input_s1, input_t1);
+        if (!stbir_build_samplers(&cache.resize))
         {
-            cout << "Failed to load image: " << filepath << endl;
-            return;
+            STBIR_FREE(output_pixels, NULL);
+            return nullptr;
         }
 
-        float aspect_ratio = (float)orig_width / (float)orig_height;
+        cache.valid = true;
+        cache.input_w = input_w;
+        cache.input_h = input_h;
+        cache.output_w = output_w;
+        cache.output_h = output_h;
+        cache.layout = layout;
+        cache.fast_alpha = options.fast_alpha;
+        cache.filter = options.filter;
+        cache.srgb = options.srgb;
+        cache.input_s1 = input_s1;
+        cache.input_t1 = input_t1;
+    }
+    else
+    {
+        stbir_set_buffer_ptrs(&cache.resize, input_pixels, 0, output_pixels, 0);
+    }
 
-        int new_width, new_height;
+    if (!stbir_resize_extended(&cache.resize))
+    {
+        STBIR_FREE(output_pixels, NULL);
+        return nullptr;
+    }
+    return output_pixels;
+}
+
+// --prefilter auto: while the remaining reduction is at least this in both directions the image is
+// halved with a 2x2 box first, so stbir's filter only does the last 2-4x over a small image instead
+// of touching dozens of input rows for every output row
+static const int PREFILTER_RATIO = 4;
+
+// One pyramid level without alpha. Odd edges average the last row/column with itself.
+template <int C>
+static void halve_box(const unsigned char *src, int w, int h, unsigned char *dst, int out_w, int out_h)
+{
+    const int pairs = w / 2;
+    for (int y = 0; y < out_h; ++y)
+    {
+        const unsigned char *row0 = src + (size_t)std::min(2 * y, h - 1) * w * C;
+        const unsigned char *row1 = src + (size_t)std::min(2 * y + 1, h - 1) * w * C;
+        unsigned char *out = dst + (size_t)y * out_w * C;
+        // plain integer adds over contiguous bytes, the compiler vectorises this loop
+        for (int x = 0; x < pairs; ++x)
+            for (int c = 0; c < C; ++c)
+                out[x * C + c] = (unsigned char)((row0[2 * x * C + c] + row0[(2 * x + 1) * C + c] +
+                                                  row1[2 * x * C + c] + row1[(2 * x + 1) * C + c] + 2) >> 2);
+        if (out_w > pairs)
+            for (int c = 0; c < C; ++c)
+                out[pairs * C + c] = (unsigned char)((row0[(w - 1) * C + c] + row1[(w - 1) * C + c] + 1) >> 1);
+    }
+}
 
-        //only one of these size params will be set or there is an error thrown validating the params
-        
-        if(_width != 0)
+// One pyramid level with straight alpha as the last channel. Colours are alpha weighted, as stbir
+// does, so fully transparent pixels don't bleed their (arbitrary) colour into the edges.
+template <int C>
+static void halve_box_alpha(const unsigned char *src, int w, int h, unsigned char *dst, int out_w, int out_h)
+{
+    for (int y = 0; y < out_h; ++y)
+    {
+        const unsigned char *row0 = src + (size_t)std::min(2 * y, h - 1) * w * C;
+        const unsigned char *row1 = src + (size_t)std::min(2 * y + 1, h - 1) * w * C;
+        unsigned char *out = dst + (size_t)y * out_w * C;
+        for (int x = 0; x < out_w; ++x)
         {
-            new_width = _width;
-            new_height = static_cast<int>(_width / aspect_ratio);
+            const int x1 = std::min(2 * x + 1, w - 1);
+            const unsigned char *p[4] = {row0 + 2 * x * C, row0 + x1 * C, row1 + 2 * x * C, row1 + x1 * C};
+            const int alpha = p[0][C - 1] + p[1][C - 1] + p[2][C - 1] + p[3][C - 1];
+            for (int c = 0; c < C - 1; ++c)
+            {
+                const int sum = alpha == 0 ? p[0][c] + p[1][c] + p[2][c] + p[3][c]
+                                           : p[0][c] * p[0][C - 1] + p[1][c] * p[1][C - 1] +
+                                                 p[2][c] * p[2][C - 1] + p[3][c] * p[3][C - 1];
+                const int weight = alpha == 0 ? 4 : alpha;
+                out[x * C + c] = (unsigned char)((sum + weight / 2) / weight);
+            }
+            out[x * C + C - 1] = (unsigned char)((alpha + 2) >> 2);
         }
-        else if(_height != 0)
+    }
+}
+
+// Halves pixels until the target is less than PREFILTER_RATIO away. Returns the reduced image
+// (free with STBIR_FREE) and updates width/height, or nullptr if no level applies.
+static unsigned char *prefilter_pyramid(const unsigned char *pixels, int &width, int &height, int channels,
+                                        int target_width, int target_height)
+{
+    unsigned char *current = nullptr;
+    while (width >= target_width * PREFILTER_RATIO && height >= target_height * PREFILTER_RATIO)
+    {
+        const int out_w = (width + 1) / 2, out_h = (height + 1) / 2;
+        unsigned char *next = (unsigned char *)STBIR_MALLOC((size_t)out_w * out_h * channels, NULL);
+        if (next == nullptr)
+            break; // stbir can still do the rest from the last level
+        const unsigned char *src = current != nullptr ? current : pixels;
+        switch (channels)
         {
-            new_height = _height;
-            new_width = static_cast<int>(_height * aspect_ratio);
+        case 1:
+            halve_box<1>(src, width, height, next, out_w, out_h);
+            break;
+        case 2:
+            halve_box_alpha<2>(src, width, height, next, out_w, out_h);
+            break;
+        case 3:
+            halve_box<3>(src, width, height, next, out_w, out_h);
+            break;
+        default:
+            halve_box_alpha<4>(src, width, height, next, out_w, out_h);
+            break;
         }
-        else //size
+        if (current != nullptr)
+            STBIR_FREE(current, NULL);
+        current = next;
+        width = out_w;
+        height = out_h;
+    }
+    return current;
+}
+
+// The resize stage for one tightly packed image: the --prefilter pyramid, then the --resize-engine.
+// extent_w/extent_h, when given, is how many input pixels (possibly fractional) the output covers.
+// Returns the output (free with STBIR_FREE), or nullptr on failure.
+static unsigned char *resize_image(const unsigned char *pixels, int width, int height, int channels,
+                                   int output_w, int output_h, const ResizeOptions &options,
+                                   double extent_w = 0, double extent_h = 0)
+{
+    // Based on the channels choose pixel layout: gray, gray+alpha (PNG, or after --detect-gray), RGB or RGBA
+    stbir_pixel_layout pixel_layout;
+    switch (channels)
+    {
+    case 1:
+        pixel_layout = STBIR_1CHANNEL;
+        break;
+    case 2:
+        pixel_layout = STBIR_RA;
+        break;
+    case 4:
+        pixel_layout = STBIR_RGBA;
+        break;
+    default:
+        pixel_layout = STBIR_RGB;
+        break;
+    }
+
+    const int full_width = width, full_height = height;
+    unsigned char *reduced = options.prefilter
+                                 ? prefilter_pyramid(pixels, width, height, channels, output_w, output_h)
+                                 : nullptr;
+    const unsigned char *resize_input = reduced != nullptr ? reduced : pixels;
+
+    double input_s1 = 1.0, input_t1 = 1.0;
+    if (extent_w > 0 || extent_h > 0)
+    {
+        // every pyramid level halves the extent as well
+        double scale = 1.0;
+        for (int w = full_width; w > width; w = (w + 1) / 2)
+            scale *= 0.5;
+        if (extent_w > 0 && extent_w < full_width)
+            input_s1 = extent_w * scale / width;
+        if (extent_h > 0 && extent_h < full_height)
+            input_t1 = extent_h * scale / height;
+    }
+
+    unsigned char *output_pixels;
+    // the fixed-point engine has no input subrect
+    if (options.engine == ENGINE_FIXED && FixedResizeSupports(channels, options.filter) && input_s1 == 1.0 && input_t1 == 1.0)
+        output_pixels = FixedResize(resize_input, width, height, channels, output_w, output_h, options.filter, options.srgb);
+    else
+        output_pixels = resize_pixels(resize_input, width, height, output_w, output_h, pixel_layout, channels, options,
+                                      input_s1, input_t1);
+    if (reduced != nullptr)
+        STBIR_FREE(reduced, NULL);
+    return output_pixels;
+}
+
+// Planar planes are resized one by one, as single channels. A plane the output wants at half the
+// first plane's size (JPEG chroma for a subsampling encoder) is resized to that size and then
+// averaged 2x2, as the encoder does with RGB input, so each sample stays centred on its luma pair
+// even for odd sizes. Half-size input planes of an odd-sized image end in half a pixel, only that
+// much of them is mapped.
+static bool resize_planes(const PixelBuffer &input, PixelBuffer &output, const ResizeOptions &options)
+{
+    if (!AllocPixels(output))
+        return false;
+
+    for (int i = 0; i < input.planes(); ++i)
+    {
+        const unsigned char *source = input.plane(i);
+        unsigned char *dst = output.plane(i);
+        const int in_w = input.width[i], in_h = input.height[i];
+        const int out_w = output.width[i], out_h = output.height[i];
+        if (in_w == out_w && in_h == out_h)
         {
-            new_width = (int)(orig_width * (_size / 100.0f));
-            new_height = (int)(orig_height * (_size / 100.0f));
+            std::memcpy(dst, source, output.plane_bytes(i));
+            continue;
         }
 
-        // Based on the channels choose pixel layout. PNGs can have 4 channels, that is the layering effect of the png
-        stbir_pixel_layout pixel_layout;
-        if (channels == 4)
-            pixel_layout = STBIR_RGBA;
+        const bool halved = i > 0 && (out_w != output.width[0] || out_h != output.height[0]) &&
+                            out_w == (output.width[0] + 1) / 2 && out_h == (output.height[0] + 1) / 2;
+        const int resize_w = halved ? output.width[0] : out_w, resize_h = halved ? output.height[0] : out_h;
+        unsigned char *resized = nullptr;
+        if (in_w != resize_w || in_h != resize_h)
+        {
+            const double extent_w = i > 0 && in_w * 2 == input.width[0] + 1 ? input.width[0] / 2.0 : 0;
+            const double extent_h = i > 0 && in_h * 2 == input.height[0] + 1 ? input.height[0] / 2.0 : 0;
+            resized = resize_image(source, in_w, in_h, 1, resize_w, resize_h, options, extent_w, extent_h);
+            if (resized == nullptr)
+            {
+                FreePixels(output);
+                return false;
+            }
+            source = resized;
+        }
+        if (halved)
+            halve_box<1>(source, resize_w, resize_h, dst, out_w, out_h);
         else
-            pixel_layout = STBIR_RGB;
-
-        unsigned char *output_pixels = stbir_resize_uint8_srgb(
-            input_pixels,
-            orig_width,
-            orig_height,
-            0,
-            NULL,
-            new_width,
-            new_height,
-            0,
-            pixel_layout);
-
-        if (output_pixels)
-        {
-            const string filename = std::filesystem::path(filepath).stem().string();
-            const string extension = std::filesystem::path(filepath).extension().string();
-            const string outputFile = _outdir + "/" + filename + "_" + std::to_string(_size) + "_" + std::to_string(_quality) + extension;
-
-            if (extension == ".png")
+            std::memcpy(dst, source, output.plane_bytes(i));
+        if (resized != nullptr)
+            STBIR_FREE(resized, NULL);
+    }
+    return true;
+}
+
+bool ResizePixelBuffer(const PixelBuffer &input, PixelBuffer &output, const ResizeOptions &options)
+{
+    output.data = nullptr;
+    if (input.layout != output.layout || input.channels != output.channels)
+        return false;
+    if (input.layout == PIXELS_PLANAR)
+        return resize_planes(input, output, options);
+    output.data = resize_image(input.data, input.width[0], input.height[0], input.channels,
+                               output.width[0], output.height[0], options);
+    return output.data != nullptr;
+}
+
+bool ComputeOutputSize(int input_width, int input_height, const ResizeOptions &options, int &output_width, int &output_height)
+{
+    float aspect_ratio = (float)input_width / (float)input_height;
+
+    //only one of these size params will be set or there is an error thrown validating the params
+    
+    if(options.width != 0)
+    {
+        output_width = options.width;
+        output_height = static_cast<int>(options.width / aspect_ratio);
+    }
+    else if(options.height != 0)
+    {
+        output_height = options.height;
+        output_width = static_cast<int>(options.height * aspect_ratio);
+    }
+    else //size
+    {
+        output_width = (int)(input_width * (options.size / 100.0f));
+        output_height = (int)(input_height * (options.size / 100.0f));
+    }
+
+    // an image already within the target bounds keeps its size, which then allows a passthrough
+    if (options.no_upscale && (output_width > input_width || output_height > input_height))
+    {
+        output_width = input_width;
+        output_height = input_height;
+        return true;
+    }
+    return false;
+}
+
+bool SetResizeGeometry(ResizeOptions &options, int width, int height, int size)
+{
+    const int given = (width != 0) + (height != 0) + (size != 0);
+    if (given > 1)
+        return false;
+    if (given == 1)
+    {
+        // ComputeOutputSize prefers width, then height, so the defaults' geometry must not linger
+        options.width = width;
+        options.height = height;
+        options.size = size != 0 ? size : 100;
+    }
+    return true;
+}
+
+void SetPngEncoderOptions(int compression_level, int filter)
+{
+    stbi_write_png_compression_level = compression_level;
+    stbi_write_force_png_filter = filter;
+}
+
+// ITU T.81 Annex K luminance table, the base every IJG-style encoder (stb included) scales
+static const int STD_LUMINANCE_QUANT[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61,
+    12, 12, 14, 19, 26, 58, 60, 55,
+    14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77,
+    24, 35, 55, 64, 81, 104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99};
+
+int EstimateJpegQuality(const unsigned char *data, size_t length)
+{
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return 0;
+
+    // walk the marker segments up to the scan, looking for DQT table 0
+    uint64_t table_sum = 0;
+    size_t pos = 2;
+    while (pos + 4 <= length && table_sum == 0)
+    {
+        if (data[pos] != 0xFF)
+            return 0;
+        const unsigned char marker = data[pos + 1];
+        if (marker == 0xFF)
+        {
+            pos++; // fill byte
+            continue;
+        }
+        if (marker == 0xDA || marker == 0xD9)
+            break;
+        const size_t segment = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+        if (segment < 2 || pos + 2 + segment > length)
+            return 0;
+
+        if (marker == 0xDB)
+        {
+            size_t p = pos + 4;
+            const size_t end = pos + 2 + segment;
+            while (p < end)
             {
-                int stride_in_bytes = new_width * channels;
-                stbi_write_png(outputFile.c_str(), new_width, new_height, channels, output_pixels, stride_in_bytes);
+                const int precision = data[p] >> 4; // 0 = 8-bit entries, 1 = 16-bit
+                const int id = data[p] & 15;
+                const size_t entries = 64 * (precision + 1);
+                if (p + 1 + entries > end)
+                    return 0;
+                if (id == 0)
+                {
+                    for (int i = 0; i < 64; ++i)
+                        table_sum += precision ? ((data[p + 1 + 2 * i] << 8) | data[p + 2 + 2 * i]) : data[p + 1 + i];
+                    break;
+                }
+                p += 1 + entries;
             }
-            else if (extension == ".jpeg" || extension == ".jpg")
+        }
+        pos += 2 + segment;
+    }
+    if (table_sum == 0)
+        return 0;
+
+    // invert the IJG scaling: table = standard * scale / 100, scale = q < 50 ? 5000 / q : 200 - 2q.
+    // Entries are summed, so the zigzag order doesn't matter and rounding of single entries averages out.
+    int standard_sum = 0;
+    for (int value : STD_LUMINANCE_QUANT)
+        standard_sum += value;
+    const double scale = 100.0 * table_sum / standard_sum;
+    const double quality = scale <= 100.0 ? (200.0 - scale) / 2.0 : 5000.0 / scale;
+    return std::min(100, std::max(1, (int)(quality + 0.5)));
+}
+
+// The output format follows the extension, true if the encoded bytes are already in that format
+static bool is_format(const unsigned char *data, size_t length, const std::string &extension)
+{
+    if (length < 4)
+        return false;
+    if (extension == ".png")
+        return std::memcmp(data, "\x89PNG", 4) == 0;
+    if (extension == ".jpg" || extension == ".jpeg")
+        return data[0] == 0xFF && data[1] == 0xD8;
+    return false;
+}
+
+bool CanPassThrough(const unsigned char *data, size_t length, const std::string &extension, const ResizeOptions &options,
+                    int &width, int &height, int &channels)
+{
+    if (length < 8 || !stbi_info_from_memory(data, (int)length, &width, &height, &channels))
+        return false;
+
+    int output_width, output_height;
+    ComputeOutputSize(width, height, options, output_width, output_height);
+    if (output_width != width || output_height != height)
+        return false;
+
+    if (!is_format(data, length, extension))
+        return false;
+    if (extension == ".png")
+        return true;
+    const int source_quality = EstimateJpegQuality(data, length);
+    return source_quality > 0 && options.quality >= source_quality;
+}
+
+// --jpeg-planar auto: a JPEG written as JPEG keeps the decoder's Y, Cb and Cr planes, chroma at its
+// stored resolution, and the encoder takes them as they are, so neither side converts colour and
+// the chroma planes are resized at a quarter of the pixels (4:2:0). YCbCr is an affine function of
+// the stored RGB values, so filtering the planes matches --colorspace linear; in sRGB mode the path
+// is only taken when luma isn't resized. --detect-gray needs the RGB pixels.
+static bool planar_jpeg_applies(const unsigned char *data, size_t length, const std::string &extension,
+                                const ResizeOptions &options)
+{
+    if (!options.planar_jpeg || options.detect_gray || !is_format(data, length, extension) || extension == ".png")
+        return false;
+    if (!options.srgb)
+        return true;
+    int width, height, channels, output_width, output_height;
+    if (!stbi_info_from_memory(data, (int)length, &width, &height, &channels))
+        return false;
+    ComputeOutputSize(width, height, options, output_width, output_height);
+    return output_width == width && output_height == height;
+}
+
+// --detect-gray: if no pixel's channels differ by more than tolerance, rewrites RGB(A) pixels in
+// place as gray(+alpha) and returns the new channel count, otherwise the old one. Colour images
+// usually fail within the first few pixels, so the scan is cheap when it doesn't pay off.
+static int collapse_gray(unsigned char *pixels, size_t count, int channels, int tolerance)
+{
+    if (channels < 3)
+        return channels;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const unsigned char *p = pixels + i * channels;
+        const int low = std::min({p[0], p[1], p[2]});
+        const int high = std::max({p[0], p[1], p[2]});
+        if (high - low > tolerance)
+            return channels;
+    }
+
+    const int gray_channels = channels == 4 ? 2 : 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // the destination never overtakes the source, so this is safe in place
+        const unsigned char *p = pixels + i * channels;
+        const unsigned char gray = (unsigned char)((p[0] + 2 * p[1] + p[2] + 2) / 4);
+        const unsigned char alpha = channels == 4 ? p[3] : 0;
+        pixels[i * gray_channels] = gray;
+        if (gray_channels == 2)
+            pixels[i * gray_channels + 1] = alpha;
+    }
+    return gray_channels;
+}
+
+// True if every pixel's alpha (its last byte) is 255. Most "RGBA" screenshots are like that, and
+// stbir would otherwise weight every pixel by an alpha that changes nothing. The scan ANDs whole
+// 8-byte words so it vectorises, and checks a block at a time to stop early on real transparency.
+static bool alpha_is_opaque(const unsigned char *pixels, size_t count, int channels)
+{
+    unsigned char pattern[8] = {};
+    for (int i = channels - 1; i < 8; i += channels)
+        pattern[i] = 0xFF;
+    uint64_t mask;
+    std::memcpy(&mask, pattern, sizeof(mask));
+
+    // 8 is a multiple of 2 and 4 channels, so every word starts on a pixel boundary
+    const size_t bytes = count * channels;
+    const size_t words = bytes / 8;
+    const size_t BLOCK = 1024;
+    for (size_t start = 0; start < words; start += BLOCK)
+    {
+        const size_t end = std::min(words, start + BLOCK);
+        uint64_t all = ~(uint64_t)0;
+        for (size_t w = start; w < end; ++w)
+        {
+            uint64_t word;
+            std::memcpy(&word, pixels + w * 8, sizeof(word));
+            all &= word;
+        }
+        if ((all & mask) != mask)
+            return false;
+    }
+    for (size_t i = words * 8 + channels - 1; i < bytes; i += channels)
+        if (pixels[i] != 0xFF)
+            return false;
+    return true;
+}
+
+// Drops the alpha byte of every pixel in place, RGBA to RGB or gray+alpha to gray. Returns the new count.
+static int drop_alpha(unsigned char *pixels, size_t count, int channels)
+{
+    const int color_channels = channels - 1;
+    for (size_t i = 0; i < count; ++i)
+        for (int c = 0; c < color_channels; ++c)
+            pixels[i * color_channels + c] = pixels[i * channels + c];
+    return color_channels;
+}
+
+// Counts an image emitted as its unchanged source: nothing decoded, resized or encoded
+static void record_passthrough(ResizeResult &r, const ResizeOptions &options, int width, int height, int channels,
+                               uint64_t length)
+{
+    int output_width, output_height;
+    r.upscale_avoided = ComputeOutputSize(width, height, options, output_width, output_height);
+
+    PipelineStats &stats = LocalStats();
+    if (r.upscale_avoided)
+        stats.upscale_avoided++;
+    stats.images++;
+    stats.passthrough++;
+    stats.bytes_in += length;
+    stats.bytes_out += length;
+    stats.skipped[STAGE_DECODE]++;
+    stats.skipped[STAGE_RESIZE]++;
+    stats.skipped[STAGE_ENCODE]++;
+
+    r.status = RESIZE_OK;
+    r.passthrough = true;
+    r.input_width = r.output_width = width;
+    r.input_height = r.output_height = height;
+    r.channels = channels;
+    r.bytes_in = r.bytes_out = length;
+}
+
+std::string ProcessingKey(const std::string &extension, const ResizeOptions &options)
+{
+    string key = "v6";
+    if (options.width != 0)
+        key += " w" + std::to_string(options.width);
+    else if (options.height != 0)
+        key += " h" + std::to_string(options.height);
+    else
+        key += " s" + std::to_string(options.size);
+    if (options.no_upscale)
+        key += " nu";
+    if (options.keep_smaller)
+        key += " ks";
+    if (options.detect_gray)
+        key += " gd";
+    if (options.fast_alpha)
+        key += " fa";
+    if (!options.prefilter)
+        key += " np";
+    if (options.filter != FILTER_DEFAULT)
+        key += string(" f") + ResizeFilterName(options.filter);
+    if (!options.srgb)
+        key += " lin";
+    if (options.engine == ENGINE_FIXED)
+        key += " fx";
+    if (!options.planar_jpeg)
+        key += " npj";
+
+    if (extension == ".png")
+        key += " png l" + std::to_string(stbi_write_png_compression_level) + " f" + std::to_string(stbi_write_force_png_filter);
+    else
+        key += " jpg q" + std::to_string(options.quality);
+    return key;
+}
+
+std::string OutputFileName(const std::string &filepath, const ResizeOptions &options)
+{
+    const string filename = std::filesystem::path(filepath).stem().string();
+    const string extension = std::filesystem::path(filepath).extension().string();
+    return filename + "_" + std::to_string(options.size) + "_" + std::to_string(options.quality) + extension;
+}
+
+static const char *const FILTER_NAMES[] = {"default", "box", "triangle", "cubic", "catmull", "mitchell", "point"};
+
+const char *ResizeFilterName(ResizeFilter filter)
+{
+    return filter >= FILTER_DEFAULT && filter <= FILTER_POINT ? FILTER_NAMES[filter] : "unknown";
+}
+
+bool ParseResizeFilter(const std::string &name, ResizeFilter &filter)
+{
+    for (int i = FILTER_DEFAULT; i <= FILTER_POINT; ++i)
+    {
+        if (name == FILTER_NAMES[i])
+        {
+            filter = (ResizeFilter)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *ResizeStatusName(ResizeStatus status)
+{
+    switch (status)
+    {
+    case RESIZE_OK:
+        return "ok";
+    case RESIZE_READ_FAILED:
+        return "read_failed";
+    case RESIZE_DECODE_FAILED:
+        return "decode_failed";
+    case RESIZE_RESIZE_FAILED:
+        return "resize_failed";
+    case RESIZE_ENCODE_FAILED:
+        return "encode_failed";
+    case RESIZE_WRITE_FAILED:
+        return "write_failed";
+    case RESIZE_EXCEPTION:
+        return "exception";
+    default:
+        return "unknown";
+    }
+}
+
+void RecordCacheHit(ResizeResult &result, const ResizeOptions &options, int width, int height, uint64_t bytes_in, uint64_t bytes_out)
+{
+    result.cache_hit = true;
+    result.bytes_in = bytes_in;
+    result.bytes_out = bytes_out;
+    PipelineStats &stats = LocalStats();
+    if (width > 0 && height > 0)
+    {
+        result.input_width = width;
+        result.input_height = height;
+        result.upscale_avoided = ComputeOutputSize(width, height, options, result.output_width, result.output_height);
+        if (result.upscale_avoided)
+            stats.upscale_avoided++;
+    }
+    stats.images++;
+    stats.bytes_in += bytes_in;
+    stats.bytes_out += bytes_out;
+}
+
+bool ResizeImageBuffer(const unsigned char *data,
+                       size_t length,
+                       const std::string &extension,
+                       const ResizeOptions &options,
+                       std::vector<unsigned char> &out_bytes,
+                       const std::string &label,
+                       ResizeResult *result,
+                       bool check_passthrough)
+{
+    ResizeResult local_result;
+    ResizeResult &r = result != nullptr ? *result : local_result;
+
+    out_bytes.clear();
+
+    int source_width, source_height, source_channels;
+    if (check_passthrough && CanPassThrough(data, length, extension, options, source_width, source_height, source_channels))
+    {
+        out_bytes.assign(data, data + length);
+        record_passthrough(r, options, source_width, source_height, source_channels, length);
+        return true;
+    }
+
+    PipelineStats &stats = LocalStats();
+    stats.bytes_in += length;
+    r.bytes_in = length;
+
+    // interleaved as stb_image decodes, or --jpeg-planar's Y, Cb, Cr planes
+    PixelBuffer input;
+    int orig_width = 0, orig_height = 0;
+    AllocResetPeak();
+    StageTimer decode_timer(STAGE_DECODE);
+    if (planar_jpeg_applies(data, length, extension, options))
+    {
+        input = MakePixelBuffer(PIXELS_PLANAR, 0, 0, 3);
+        input.data = stbi_load_jpeg_ycbcr_from_memory(data, (int)length, &orig_width, &orig_height, input.width, input.height);
+    }
+    if (input.data == nullptr) // gray, RGB coded or CMYK JPEGs go the usual way
+    {
+        int channels = 0;
+        unsigned char *pixels = stbi_load_from_memory(data, (int)length, &orig_width, &orig_height, &channels, 0);
+        input = MakePixelBuffer(PIXELS_INTERLEAVED, orig_width, orig_height, channels);
+        input.data = pixels;
+    }
+    r.stage_ns[STAGE_DECODE] = decode_timer.stop();
+    r.peak_bytes[STAGE_DECODE] = AllocPeakBytes();
+
+    if (input.data == nullptr)
+    {
+        cout << "Failed to load image: " << label << endl;
+        stats.failures++;
+        r.status = RESIZE_DECODE_FAILED;
+        return false;
+    }
+    stats.pixels_in += (uint64_t)orig_width * orig_height;
+
+    if (input.layout == PIXELS_INTERLEAVED)
+    {
+        // JPEG chroma subsampling leaves gray scans a level or two off neutral, PNG must be exact
+        if (options.detect_gray && input.channels >= 3)
+        {
+            const int gray_channels = collapse_gray(input.data, (size_t)orig_width * orig_height, input.channels,
+                                                    extension == ".png" ? 0 : 2);
+            if (gray_channels != input.channels)
             {
-                stbi_write_jpg(outputFile.c_str(), new_width, new_height, channels, output_pixels, _quality);
+                input.channels = gray_channels;
+                stats.gray_collapsed++;
             }
         }
-        else
+        // opaque alpha carries nothing, resizing and encoding without it is cheaper and the file smaller
+        if ((input.channels == 2 || input.channels == 4) && alpha_is_opaque(input.data, (size_t)orig_width * orig_height, input.channels))
         {
-            cout << "ERROR **** Failed to resize image: " << filepath << endl;
+            input.channels = drop_alpha(input.data, (size_t)orig_width * orig_height, input.channels);
+            stats.alpha_dropped++;
         }
+    }
+    const int channels = input.channels;
+    r.input_width = orig_width;
+    r.input_height = orig_height;
+    r.channels = channels;
+
+    int new_width, new_height;
+    r.upscale_avoided = ComputeOutputSize(orig_width, orig_height, options, new_width, new_height);
+    if (r.upscale_avoided)
+        stats.upscale_avoided++;
+
+    // the encoder's plane sizes: chroma at half size when it subsamples at this quality
+    PixelBuffer output = MakePixelBuffer(input.layout, new_width, new_height, channels);
+    if (input.layout == PIXELS_PLANAR && stbi_write_jpg_subsamples(options.quality))
+    {
+        output.width[1] = output.width[2] = (new_width + 1) / 2;
+        output.height[1] = output.height[2] = (new_height + 1) / 2;
+    }
+    bool same_size = true;
+    for (int i = 0; i < input.planes(); ++i)
+        same_size = same_size && input.width[i] == output.width[i] && input.height[i] == output.height[i];
 
-        STBIR_FREE(output_pixels, NULL); // Free the resize output
-        stbi_image_free(input_pixels);   // Free the original image
+    // same geometry (re-encoding at another quality, say), the decoded pixels go straight to the encoder
+    if (same_size)
+    {
+        output.data = input.data;
+        stats.skipped[STAGE_RESIZE]++;
+    }
+    else
+    {
+        // Y'CbCr planes are filtered as stored values, see planar_jpeg_applies
+        ResizeOptions resize_options = options;
+        if (input.layout == PIXELS_PLANAR)
+            resize_options.srgb = false;
+        AllocResetPeak();
+        StageTimer resize_timer(STAGE_RESIZE);
+        ResizePixelBuffer(input, output, resize_options);
+        r.stage_ns[STAGE_RESIZE] = resize_timer.stop();
+        r.peak_bytes[STAGE_RESIZE] = AllocPeakBytes();
+    }
+
+    bool encoded = false;
+    if (output.data)
+    {
+        AllocResetPeak();
+        StageTimer encode_timer(STAGE_ENCODE);
+        if (extension == ".png")
+        {
+            int stride_in_bytes = new_width * channels;
+            encoded = stbi_write_png_to_func(append_to_vector, &out_bytes, new_width, new_height, channels, output.data, stride_in_bytes) != 0;
+        }
+        else if (output.layout == PIXELS_PLANAR)
+        {
+            const unsigned char *const planes[3] = {output.plane(0), output.plane(1), output.plane(2)};
+            encoded = stbi_write_jpg_ycbcr_to_func(append_to_vector, &out_bytes, new_width, new_height, planes, options.quality) != 0;
+        }
+        else if (extension == ".jpeg" || extension == ".jpg")
+        {
+            encoded = stbi_write_jpg_to_func(append_to_vector, &out_bytes, new_width, new_height, channels, output.data, options.quality) != 0;
+        }
+        r.stage_ns[STAGE_ENCODE] = encode_timer.stop();
+        r.peak_bytes[STAGE_ENCODE] = AllocPeakBytes();
+        r.status = encoded ? RESIZE_OK : RESIZE_ENCODE_FAILED;
+    }
+    else
+    {
+        cout << "ERROR **** Failed to resize image: " << label << endl;
+        r.status = RESIZE_RESIZE_FAILED;
+    }
+
+    if (output.data != input.data)
+        FreePixels(output); // Free the resize output
+    FreePixels(input);      // Free the original image
+
+    // the source wins ties too, it is at least as good as any re-encode of itself
+    if (encoded && options.keep_smaller && out_bytes.size() >= length && is_format(data, length, extension))
+    {
+        out_bytes.assign(data, data + length);
+        new_width = orig_width;
+        new_height = orig_height;
+        r.kept_source = true;
+        stats.kept_source++;
+    }
+
+    if (encoded)
+    {
+        stats.images++;
+        stats.bytes_out += out_bytes.size();
+        stats.pixels_out += (uint64_t)new_width * new_height;
+        r.bytes_out = out_bytes.size();
+        r.output_width = new_width;
+        r.output_height = new_height;
+        stats.record_peak_memory(r.peak_bytes, orig_width, orig_height);
+    }
+    else
+        stats.failures++;
+
+    return encoded;
+}
+
+ResizeResult ResizeImage(const std::string &filepath,
+                         const std::string &_outdir,
+                         const ResizeOptions &options,
+                         ResultCache *cache)
+{
+    ResizeResult result;
+    result.input_path = filepath;
+
+    try
+    {
+        std::vector<unsigned char> input_bytes;
+        StageTimer read_timer(STAGE_READ);
+        if (!ReadFileBytes(filepath, input_bytes))
+        {
+            cout << "Failed to load image: " << filepath << endl;
+            LocalStats().failures++;
+            result.status = RESIZE_READ_FAILED;
+            return result;
+        }
+        result.stage_ns[STAGE_READ] = read_timer.stop();
+
+        const string extension = std::filesystem::path(filepath).extension().string();
+        const string outputFile = _outdir + "/" + OutputFileName(filepath, options);
+
+        // nothing to change, the source file is cloned (reflink or copy_file_range where available)
+        int source_width = 0, source_height = 0, source_channels = 0;
+        if (CanPassThrough(input_bytes.data(), input_bytes.size(), extension, options, source_width, source_height, source_channels))
+        {
+            result.output_path = outputFile;
+            StageTimer write_timer(STAGE_WRITE);
+            if (CloneFile(filepath, outputFile))
+            {
+                record_passthrough(result, options, source_width, source_height, source_channels, input_bytes.size());
+            }
+            else
+            {
+                cout << "ERROR **** Failed to write image: " << outputFile << endl;
+                LocalStats().failures++;
+                result.status = RESIZE_WRITE_FAILED;
+            }
+            result.stage_ns[STAGE_WRITE] = write_timer.stop();
+            return result;
+        }
+
+        // a hit is cloned straight from the cache file, the output bytes never pass through memory
+        string key;
+        if (cache != nullptr)
+        {
+            key = cache->key_for(input_bytes.data(), input_bytes.size(), extension, options);
+            if (!cache->claim(key, extension))
+            {
+                StageTimer write_timer(STAGE_WRITE);
+                if (cache->fetch_to_file(key, extension, outputFile))
+                {
+                    result.stage_ns[STAGE_WRITE] = write_timer.stop();
+                    result.output_path = outputFile;
+                    RecordCacheHit(result, options, source_width, source_height, input_bytes.size(), std::filesystem::file_size(outputFile));
+                    return result;
+                }
+                key.clear(); // evicted by another process in between, resize it uncached
+            }
+        }
+
+        std::vector<unsigned char> output_bytes;
+        bool resized = false;
+        try
+        {
+            resized = ResizeImageBuffer(input_bytes.data(), input_bytes.size(), extension, options, output_bytes, filepath, &result, false);
+        }
+        catch (...)
+        {
+            if (!key.empty())
+                cache->abandon(key, extension);
+            throw;
+        }
+        if (!key.empty())
+        {
+            if (resized)
+                cache->publish(key, extension, output_bytes.data(), output_bytes.size());
+            else
+                cache->abandon(key, extension);
+        }
+        if (!resized)
+            return result;
+
+        result.output_path = outputFile;
+        StageTimer write_timer(STAGE_WRITE);
+        const bool written = result.kept_source ? CloneFile(filepath, outputFile)
+                                                : WriteFileBytes(outputFile, output_bytes.data(), output_bytes.size());
+        if (!written)
+        {
+            cout << "ERROR **** Failed to write image: " << outputFile << endl;
+            LocalStats().failures++;
+            result.status = RESIZE_WRITE_FAILED;
+        }
+        result.stage_ns[STAGE_WRITE] = write_timer.stop();
     }
     catch (const std::exception &e)
     {
         cout << "Exception occurred while processing image: " << filepath << ". Error: " << e.what() << endl;
-        return;
+        result.status = RESIZE_EXCEPTION;
+        return result;
     }
 
-    return;
-}
\ No newline at end of file
+    return result;
+}
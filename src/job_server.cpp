@@ -0,0 +1,360 @@
+#include "job_server.h"
+#include <iostream>
+
+#ifdef _WIN32
+
+int RunJobServer(const std::string &socket_path, unsigned int threads, const ResizeOptions &defaults)
+{
+    std::cout << "Error: --serve needs Unix domain sockets and is not supported on Windows." << std::endl;
+    return 1;
+}
+
+#else
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "blocking_queue.h"
+#include "file_helpers.h"
+#include "latency_recorder.h"
+#include "net_helpers.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// largest inline payload a client may send
+static const size_t MAX_INLINE_BYTES = 512u * 1024 * 1024;
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int)
+{
+    stop_requested = 1;
+}
+
+struct ServerResult
+{
+    bool ok = false;
+    string error;
+    std::vector<unsigned char> bytes;
+    ResizeResult resize;
+    string path;
+    size_t output_size = 0;
+};
+
+struct ServerJob
+{
+    string src;
+    std::vector<unsigned char> input;
+    string extension;
+    ResizeOptions options;
+    string out_path;
+    std::promise<ServerResult> result;
+};
+
+static void run_job(ServerJob &job, ServerResult &result)
+{
+    if (job.input.empty() && !ReadFileBytes(job.src, job.input))
+    {
+        result.error = "cannot read " + job.src;
+        return;
+    }
+
+    const string label = job.src.empty() ? "<inline>" : job.src;
+    if (!ResizeImageBuffer(job.input.data(), job.input.size(), job.extension, job.options, result.bytes, label, &result.resize))
+    {
+        result.error = "failed to decode, resize or encode " + label;
+        return;
+    }
+    result.output_size = result.bytes.size();
+
+    if (!job.out_path.empty())
+    {
+        if (!WriteFileBytes(job.out_path, result.bytes.data(), result.bytes.size()))
+        {
+            result.error = "cannot write " + job.out_path;
+            return;
+        }
+        result.path = job.out_path;
+        result.bytes.clear();
+    }
+    result.ok = true;
+}
+
+static string extension_for_format(const string &format)
+{
+    if (format == "png")
+        return ".png";
+    if (format == "jpg" || format == "jpeg")
+        return ".jpg";
+    return "";
+}
+
+// Fills job from a RESIZE request. Returns an error message, or "" if the request is valid.
+static string parse_resize_request(const std::map<string, string> &args, SocketReader &reader, ServerJob &job)
+{
+    auto get = [&args](const char *key) -> string
+    {
+        auto it = args.find(key);
+        return it == args.end() ? string() : it->second;
+    };
+
+    int width = 0, height = 0, size = 0;
+    try
+    {
+        if (!get("width").empty())
+            width = std::stoi(get("width"));
+        if (!get("height").empty())
+            height = std::stoi(get("height"));
+        if (!get("size").empty())
+            size = std::stoi(get("size"));
+        if (!get("quality").empty())
+            job.options.quality = std::stoi(get("quality"));
+    }
+    catch (const std::exception &)
+    {
+        return "invalid numeric option";
+    }
+    if (width < 0 || height < 0 || (!get("size").empty() && size <= 0) ||
+        job.options.quality < 1 || job.options.quality > 100)
+        return "option out of range";
+    if (!SetResizeGeometry(job.options, width, height, size))
+        return "only one of width=, height= or size= may be given";
+
+    job.src = get("src");
+    if (!get("bytes").empty())
+    {
+        size_t length = 0;
+        try
+        {
+            length = std::stoull(get("bytes"));
+        }
+        catch (const std::exception &)
+        {
+            return "invalid bytes";
+        }
+        if (length == 0 || length > MAX_INLINE_BYTES)
+            return "bytes out of range";
+        if (!reader.read_exact(job.input, length))
+            return "truncated payload";
+    }
+    else if (job.src.empty())
+        return "src= or bytes= is required";
+
+    job.extension = extension_for_format(get("format"));
+    if (job.extension.empty() && !job.src.empty())
+        job.extension = std::filesystem::path(job.src).extension().string();
+    if (job.extension.empty() && job.input.size() > 4 && std::memcmp(job.input.data(), "\x89PNG", 4) == 0)
+        job.extension = ".png";
+    if (job.extension.empty())
+        job.extension = ".jpg";
+    if (job.extension != ".png" && job.extension != ".jpg" && job.extension != ".jpeg")
+        return "unsupported format " + job.extension;
+
+    job.out_path = get("out");
+    if (job.out_path.empty() && !get("outdir").empty())
+    {
+        const string name = job.src.empty() ? "image" + job.extension : job.src;
+        job.out_path = (std::filesystem::path(get("outdir")) / OutputFileName(name, job.options)).string();
+    }
+    return "";
+}
+
+int RunJobServer(const std::string &socket_path, unsigned int threads, const ResizeOptions &defaults)
+{
+    if (threads == 0)
+        threads = 1;
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path))
+    {
+        cout << "Error: Socket path is too long: " << socket_path << endl;
+        return 1;
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // a socket file left behind by a previous run would make bind fail
+    struct stat st;
+    if (::lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        ::unlink(socket_path.c_str());
+
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || ::bind(listen_fd, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(listen_fd, 128) != 0)
+    {
+        cout << "Error: Could not listen on " << socket_path << ": " << std::strerror(errno) << endl;
+        if (listen_fd >= 0)
+            ::close(listen_fd);
+        return 1;
+    }
+
+    std::signal(SIGINT, handle_stop_signal);
+    std::signal(SIGTERM, handle_stop_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    BlockingQueue<std::unique_ptr<ServerJob>> jobs(threads * 4);
+    LatencyRecorder latency;
+    std::atomic<unsigned long long> errors{0};
+
+    // Warm worker pool, the threads (and their thread-local caches) live as long as the server
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&jobs]()
+        {
+            std::unique_ptr<ServerJob> job;
+            while (jobs.pop(job))
+            {
+                ServerResult result;
+                try
+                {
+                    run_job(*job, result);
+                }
+                catch (const std::exception &e)
+                {
+                    result.ok = false;
+                    result.error = e.what();
+                }
+                job->result.set_value(std::move(result));
+            }
+        });
+    }
+
+    // Connections are served by their own lightweight threads which only parse and wait
+    std::mutex clients_mutex;
+    std::condition_variable clients_done;
+    std::set<int> client_fds;
+
+    auto serve_client = [&](int fd)
+    {
+        SocketReader reader(fd);
+        string line;
+        while (reader.read_line(line))
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const size_t space = line.find(' ');
+            const string command = line.substr(0, space);
+            const auto args = ParseKeyValues(space == string::npos ? string() : line.substr(space + 1), ' ');
+
+            if (command == "QUIT")
+                break;
+            if (command == "PING")
+            {
+                if (!SendAll(fd, "OK\n", 3))
+                    break;
+                continue;
+            }
+            if (command == "STATS")
+            {
+                const string response = "OK " + latency.format() + " errors=" + std::to_string(errors.load()) + "\n";
+                if (!SendAll(fd, response.data(), response.size()))
+                    break;
+                continue;
+            }
+            if (command != "RESIZE")
+            {
+                const string response = "ERR unknown command " + PercentEncode(command) + "\n";
+                if (!SendAll(fd, response.data(), response.size()))
+                    break;
+                continue;
+            }
+
+            auto job = std::make_unique<ServerJob>();
+            job->options = defaults;
+            string error = parse_resize_request(args, reader, *job);
+
+            ServerResult result;
+            if (error.empty())
+            {
+                std::future<ServerResult> pending = job->result.get_future();
+                if (!jobs.push(std::move(job)))
+                    break; // shutting down
+                result = pending.get();
+                error = result.ok ? "" : result.error;
+            }
+
+            const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            latency.record(elapsed_ms);
+
+            string response;
+            if (!error.empty())
+            {
+                errors++;
+                response = "ERR " + error + "\n";
+            }
+            else
+            {
+                response = "OK ";
+                if (!result.path.empty())
+                    response += "path=" + PercentEncode(result.path) + " ";
+                response += "bytes=" + std::to_string(result.output_size) +
+                            " width=" + std::to_string(result.resize.output_width) +
+                            " height=" + std::to_string(result.resize.output_height) +
+                            " channels=" + std::to_string(result.resize.channels) +
+                            " ms=" + std::to_string(elapsed_ms) + "\n";
+            }
+
+            if (!SendAll(fd, response.data(), response.size()) ||
+                (!result.bytes.empty() && !SendAll(fd, result.bytes.data(), result.bytes.size())))
+                break;
+        }
+
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        client_fds.erase(fd);
+        ::close(fd);
+        clients_done.notify_all();
+    };
+
+    cout << "Serving resize jobs on " << socket_path << " with " << threads << " worker threads (Ctrl+C to stop)" << endl;
+
+    while (!stop_requested)
+    {
+        pollfd waiting = {listen_fd, POLLIN, 0};
+        if (::poll(&waiting, 1, 200) <= 0)
+            continue;
+
+        int client_fd = ::accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+            continue;
+
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        client_fds.insert(client_fd);
+        std::thread(serve_client, client_fd).detach();
+    }
+
+    cout << "Stopping server ..." << endl;
+    ::close(listen_fd);
+    ::unlink(socket_path.c_str());
+
+    // wake every connection blocked in recv and wait for them to unwind
+    {
+        std::unique_lock<std::mutex> lock(clients_mutex);
+        for (int fd : client_fds)
+            ::shutdown(fd, SHUT_RDWR);
+        clients_done.wait(lock, [&client_fds]() { return client_fds.empty(); });
+    }
+
+    jobs.close();
+    for (std::thread &worker : workers)
+        worker.join();
+
+    cout << "Requests: " << latency.format() << " errors=" << errors.load() << endl;
+    return 0;
+}
+
+#endif
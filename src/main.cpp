@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <filesystem>
@@ -6,15 +7,48 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <memory>
 #include "image_processor.h"
 #include "arg_helper.h"
+#include "blocking_queue.h"
+#include "file_helpers.h"
+#include "tar_stream.h"
+#include "pack_store.h"
+#include "job_server.h"
+#include "http_server.h"
+#include "watch_mode.h"
+#include "scaling_sweep.h"
+#include "autotune.h"
+#include "planner.h"
+#include "tuning_profile.h"
+#include "stats.h"
+#include "trace.h"
+#include "report_writer.h"
+#include "result_cache.h"
 
 using std::cout;
 using std::endl;
 using std::string;
 
+// One unit of work for the resize workers. Directory inputs only carry the path,
+// tar members carry their bytes so workers decode straight from memory.
+struct ImageJob
+{
+    string name;
+    std::vector<unsigned char> data;
+    bool in_memory = false;
+};
+
 void print_progress(int processed, int total) {
 
+    if (total <= 0)
+    {
+        // streamed input (tar), the total isn't known up front
+        std::cout << "\rProcessed " << processed << " files";
+        std::cout.flush();
+        return;
+    }
+
     const short bar_width = 60;
     float progress = (float)processed / total;
 
@@ -33,11 +67,41 @@ void print_progress(int processed, int total) {
     std::cout.flush(); // Ensure it prints immediately
 }
 
+// --pack-get: look one image up in a pack and write its bytes to stdout (metadata goes to stderr)
+int run_pack_get(const string &pack_path, const string &name)
+{
+    PackReader reader(pack_path);
+    if (!reader.is_open())
+    {
+        std::cerr << "Error: Could not open pack (or its .idx): " << pack_path << endl;
+        return 1;
+    }
+
+    PackEntry entry;
+    if (!reader.find(name, entry))
+    {
+        std::cerr << "Error: " << name << " not found in " << pack_path << " (" << reader.size() << " entries)" << endl;
+        return 1;
+    }
+
+    std::vector<unsigned char> data;
+    if (!reader.read(entry, data))
+    {
+        std::cerr << "Error: Failed to read " << name << " from " << pack_path << endl;
+        return 1;
+    }
+
+    std::cerr << entry.name << ": " << PackFormatName(entry.format) << " " << entry.width << "x" << entry.height
+              << "x" << (int)entry.channels << ", " << entry.length << " bytes at offset " << entry.offset << endl;
+    std::fwrite(data.data(), 1, data.size(), stdout);
+    std::fflush(stdout);
+    return 0;
+}
+
 int main(int argc, char *argv[], char *envp[])
 {
     // add a stopwatch
     auto start = std::chrono::high_resolution_clock::now();
-    cout << "ImageCompressCpp - starting ...." << endl;
 
     // CLI Args
     string _imgdir;
@@ -46,7 +110,42 @@ int main(int argc, char *argv[], char *envp[])
     int _quality = 100;
     int _width = 0;
     int _height = 0;
+    bool _no_upscale = false;
+    bool _keep_smaller = false;
+    bool _detect_gray = false;
+    bool _fast_alpha = false;
+    bool _prefilter = true;
+    ResizeFilter _filter = FILTER_DEFAULT;
+    bool _srgb = true;
+    ResizeEngine _engine = ENGINE_STB;
+    bool _planar_jpeg = true;
     string _imgname;
+    string _input_tar;
+    string _output_tar;
+    string _output_pack;
+    string _pack_get;
+    string _pack_get_name;
+    string _serve;
+    int _http_port = 0;
+    int _http_cache_mb = 256;
+    bool _watch = false;
+    bool _recursive = false;
+    int _debounce_ms = 200;
+    bool _stats = false;
+    bool _perf_counters = false;
+    string _trace;
+    string _report;
+    string _cache_dir;
+    int _cache_max_mb = 1024;
+    bool _scaling_sweep = false;
+    int _sweep_files = 200;
+    bool _autotune = false;
+    bool _plan = false;
+    string _profile;
+    bool _no_profile = false;
+    int _png_level = 0;   // 0 = from the tuning profile, else stb's default
+    int _png_filter = -2; // -2 = from the tuning profile, else adaptive
+    bool _threads_set = false;
 
     unsigned int _threads = std::thread::hardware_concurrency();
     unsigned int _hardware_cores = _threads;
@@ -70,15 +169,124 @@ int main(int argc, char *argv[], char *envp[])
             _width = std::stoi(argv[++i]);
         else if (arg == "--height")
             _height = std::stoi(argv[++i]);
+        else if (arg == "--no-upscale")
+            _no_upscale = true;
+        else if (arg == "--keep-smaller")
+            _keep_smaller = true;
+        else if (arg == "--detect-gray")
+            _detect_gray = true;
+        else if (arg == "--fast-alpha")
+            _fast_alpha = true;
+        else if (arg == "--prefilter")
+        {
+            const string mode = argv[++i];
+            if (mode != "auto" && mode != "off")
+            {
+                cout << "Error: --prefilter must be auto or off." << endl;
+                return 1;
+            }
+            _prefilter = mode == "auto";
+        }
+        else if (arg == "--filter")
+        {
+            if (!ParseResizeFilter(argv[++i], _filter))
+            {
+                cout << "Error: --filter must be box, triangle, cubic, catmull, mitchell, point or default." << endl;
+                return 1;
+            }
+        }
+        else if (arg == "--colorspace")
+        {
+            const string space = argv[++i];
+            if (space != "srgb" && space != "linear")
+            {
+                cout << "Error: --colorspace must be srgb or linear." << endl;
+                return 1;
+            }
+            _srgb = space == "srgb";
+        }
+        else if (arg == "--resize-engine")
+        {
+            const string engine = argv[++i];
+            if (engine != "stb" && engine != "fixed")
+            {
+                cout << "Error: --resize-engine must be stb or fixed." << endl;
+                return 1;
+            }
+            _engine = engine == "fixed" ? ENGINE_FIXED : ENGINE_STB;
+        }
+        else if (arg == "--jpeg-planar")
+        {
+            const string mode = argv[++i];
+            if (mode != "auto" && mode != "off")
+            {
+                cout << "Error: --jpeg-planar must be auto or off." << endl;
+                return 1;
+            }
+            _planar_jpeg = mode == "auto";
+        }
         else if (arg == "--quality")
             _quality = std::stoi(argv[++i]);
         else if (arg == "--imgname")
             _imgname = argv[++i];
+        else if (arg == "--input-tar")
+            _input_tar = argv[++i];
+        else if (arg == "--output-tar")
+            _output_tar = argv[++i];
+        else if (arg == "--output-pack")
+            _output_pack = argv[++i];
+        else if (arg == "--serve")
+            _serve = argv[++i];
+        else if (arg == "--http")
+            _http_port = std::stoi(argv[++i]);
+        else if (arg == "--http-cache-mb")
+            _http_cache_mb = std::stoi(argv[++i]);
+        else if (arg == "--stats")
+            _stats = true;
+        else if (arg == "--perf-counters")
+            _perf_counters = _stats = true;
+        else if (arg == "--trace")
+            _trace = argv[++i];
+        else if (arg == "--report")
+            _report = argv[++i];
+        else if (arg == "--cache-dir")
+            _cache_dir = argv[++i];
+        else if (arg == "--cache-max-mb")
+            _cache_max_mb = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--scaling-sweep")
+            _scaling_sweep = true;
+        else if (arg == "--sweep-files")
+            _sweep_files = std::max(1, std::stoi(argv[++i]));
+        else if (arg == "--autotune")
+            _autotune = true;
+        else if (arg == "--plan")
+            _plan = true;
+        else if (arg == "--profile")
+            _profile = argv[++i];
+        else if (arg == "--no-profile")
+            _no_profile = true;
+        else if (arg == "--png-level")
+            _png_level = std::min(9, std::max(1, std::stoi(argv[++i])));
+        else if (arg == "--png-filter")
+            _png_filter = std::min(4, std::max(-1, std::stoi(argv[++i])));
+        else if (arg == "--watch")
+            _watch = true;
+        else if (arg == "--recursive")
+            _recursive = true;
+        else if (arg == "--debounce-ms")
+            _debounce_ms = std::max(0, std::stoi(argv[++i]));
+        else if (arg == "--pack-get")
+        {
+            _pack_get = argv[++i];
+            if (i + 1 < argc)
+                _pack_get_name = argv[++i];
+        }
         else if (arg == "--threads")
         {
             int thread_arg = std::stoi(argv[++i]);
             if (thread_arg > 0)
             {
+                _threads_set = true;
                 if (thread_arg > _hardware_cores)
                     _threads = _hardware_cores;
                 else
@@ -88,37 +296,164 @@ int main(int argc, char *argv[], char *envp[])
 
     } // End of CLI parsing loop
 
-    if (!validate_params(_imgdir, _outdir, _size, _quality, _width, _height))
+    if (!_pack_get.empty())
+        return run_pack_get(_pack_get, _pack_get_name);
+
+    // the tar stream owns stdout, send all console output to stderr instead
+    if (_output_tar == "-")
+        cout.rdbuf(std::cerr.rdbuf());
+
+    // settings found by --autotune on this host, explicit flags take precedence
+    if (_profile.empty())
+        _profile = DefaultTuningProfilePath();
+    bool _profile_threads = false;
+    TuningProfile profile;
+    if (!_autotune && !_no_profile && LoadTuningProfile(_profile, profile))
+    {
+        if (profile.cores != _hardware_cores)
+        {
+            cout << "Ignoring tuning profile " << _profile << ", it was made for " << profile.cores
+                 << " hardware threads (run --autotune again)" << endl;
+        }
+        else
+        {
+            cout << "Using tuning profile " << _profile << endl;
+            if (!_threads_set && profile.threads > 0)
+            {
+                _threads = profile.threads; // may be above the core count, the profile measured it
+                _profile_threads = true;
+            }
+            if (_png_level == 0)
+                _png_level = profile.png_level;
+            if (_png_filter == -2)
+                _png_filter = profile.png_filter;
+        }
+    }
+    SetPngEncoderOptions(_png_level > 0 ? _png_level : 8, _png_filter >= -1 ? _png_filter : -1);
+
+    // every mode resizes with these, the servers take them as per-job defaults
+    if (!validate_resize_params(_size, _quality, _width, _height))
+        return 1;
+
+    ResizeOptions options;
+    options.size = _size;
+    options.quality = _quality;
+    options.width = _width;
+    options.height = _height;
+    options.no_upscale = _no_upscale;
+    options.keep_smaller = _keep_smaller;
+    options.detect_gray = _detect_gray;
+    options.fast_alpha = _fast_alpha;
+    options.prefilter = _prefilter;
+    options.filter = _filter;
+    options.srgb = _srgb;
+    options.engine = _engine;
+    options.planar_jpeg = _planar_jpeg;
+
+    if (!_serve.empty())
+        return RunJobServer(_serve, _threads, options);
+
+    if (_http_port != 0)
+    {
+        if (_imgdir.empty() || !std::filesystem::is_directory(_imgdir))
+        {
+            cout << "Error: --http needs --imgdir <path> as the root that src= is resolved against." << endl;
+            return 1;
+        }
+        return RunHttpServer(_http_port, _imgdir, _threads, (size_t)std::max(_http_cache_mb, 0) * 1024 * 1024, options);
+    }
+
+    if (_scaling_sweep)
+    {
+        if (_imgdir.empty() || !std::filesystem::is_directory(_imgdir))
+        {
+            cout << "Error: --scaling-sweep needs --imgdir <path> with sample images." << endl;
+            return 1;
+        }
+        return RunScalingSweep(_imgdir, _imgname, (size_t)_sweep_files, options);
+    }
+
+    if (_autotune)
+    {
+        if (_imgdir.empty() || !std::filesystem::is_directory(_imgdir))
+        {
+            cout << "Error: --autotune needs --imgdir <path> with sample images." << endl;
+            return 1;
+        }
+        return RunAutotune(_imgdir, _imgname, (size_t)_sweep_files, options, _profile);
+    }
+
+    if (_plan)
+    {
+        if (_imgdir.empty() || !std::filesystem::is_directory(_imgdir))
+        {
+            cout << "Error: --plan needs --imgdir <path>." << endl;
+            return 1;
+        }
+        // same thread count the real run would pick
+        unsigned int threads = _threads;
+        if (!_profile_threads && threads == _hardware_cores && _hardware_cores > 7)
+            threads -= 2;
+        return RunPlan(_imgdir, _imgname, threads, options, profile.model);
+    }
+
+    if (!validate_params(_imgdir, _outdir, _input_tar, _output_tar, _output_pack))
     {
         return 1; // exit on invalid args
     }
 
+    cout << "ImageCompressCpp - starting ...." << endl;
+
     // creates outdir if it doesn't exist
-    std::filesystem::create_directories(_outdir);
+    if (!_outdir.empty())
+        std::filesystem::create_directories(_outdir);
+
+    if (_watch)
+    {
+        if (!_input_tar.empty() || _outdir.empty())
+        {
+            cout << "Error: --watch works on --imgdir and --outdir only." << endl;
+            return 1;
+        }
+        return RunWatchMode(_imgdir, _outdir, _recursive, _debounce_ms, _threads, options);
+    }
+
+    if (_perf_counters)
+    {
+        string reason;
+        if (!PerfCountersEnable(reason))
+            cout << "Hardware counters disabled, " << reason << endl;
+    }
+
+    if (!_trace.empty())
+    {
+        TraceEnable();
+        TraceSetThreadName("main");
+    }
 
     std::vector<string> allImgFiles;
 
-    for (const auto &entry : std::filesystem::directory_iterator(_imgdir))
+    if (_input_tar.empty())
     {
-        if (entry.is_regular_file())
+        TraceScope discovery_scope("discovery");
+        for (const auto &entry : std::filesystem::directory_iterator(_imgdir))
         {
-            string filepath = entry.path().string();
-            if (!_imgname.empty())
+            if (entry.is_regular_file())
             {
-                // if imgname is specified, only add that file if it matches
-                if (entry.path().filename() == _imgname)
+                string filepath = entry.path().string();
+                if (!_imgname.empty())
+                {
+                    // if imgname is specified, only add that file if it matches
+                    if (entry.path().filename() == _imgname)
+                    {
+                        allImgFiles.push_back(filepath);
+                    }
+                    continue;
+                }
+                if (IsSupportedImage(filepath))
                 {
                     allImgFiles.push_back(filepath);
                 }
-                continue;
-            }
-            if (entry.path().extension() == ".jpg" || entry.path().extension() == ".jpeg")
-            {
-                allImgFiles.push_back(filepath);
-            }
-            else if (entry.path().extension() == ".png")
-            {
-                allImgFiles.push_back(filepath);
             }
         }
     }
@@ -126,60 +461,258 @@ int main(int argc, char *argv[], char *envp[])
     unsigned int originalFileCount = allImgFiles.size();
     std::atomic<unsigned int> processedFileCount{0};
     std::atomic<unsigned int> fileIndex{0};
+    std::atomic<bool> workersDone{false};
 
     // adjust threads to match file count if less files than threads
-    if (allImgFiles.size() < _threads)
+    if (_input_tar.empty() && allImgFiles.size() < _threads)
     {
         _threads = allImgFiles.size();
     }
 
     // on a higher core cpus, leave two cores free for OS and Monitor thread
-    if (_threads == _hardware_cores && _hardware_cores > 7)
+    if (!_profile_threads && _threads == _hardware_cores && _hardware_cores > 7)
     {
         _threads -= 2;
     }
 
-    cout << "Found " << allImgFiles.size() << " image files in directory: " << _imgdir << endl;
-    cout << "Moving resized images to output directory: " << _outdir << endl;
+    // Tar input is read sequentially on the main thread, tar output is appended by one writer thread.
+    // The queues are bounded so neither side buffers more than a few images per worker.
+    std::unique_ptr<TarReader> tarReader;
+    std::unique_ptr<TarWriter> tarWriter;
+    std::unique_ptr<PackWriter> packWriter;
+    BlockingQueue<ImageJob> inputQueue(_threads * 4);
+    BlockingQueue<TarMember> outputQueue(_threads * 4);
+
+    if (!_input_tar.empty())
+    {
+        tarReader = std::make_unique<TarReader>(_input_tar);
+        if (!tarReader->is_open())
+        {
+            cout << "Error: Could not open input tar: " << _input_tar << endl;
+            return 1;
+        }
+        cout << "Reading images from tar archive: " << _input_tar << endl;
+    }
+    else
+    {
+        cout << "Found " << allImgFiles.size() << " image files in directory: " << _imgdir << endl;
+    }
+
+    if (!_output_tar.empty())
+    {
+        tarWriter = std::make_unique<TarWriter>(_output_tar);
+        if (!tarWriter->is_open())
+        {
+            cout << "Error: Could not create output tar: " << _output_tar << endl;
+            return 1;
+        }
+        cout << "Writing resized images to tar archive: " << _output_tar << endl;
+    }
+    else if (!_output_pack.empty())
+    {
+        packWriter = std::make_unique<PackWriter>(_output_pack);
+        if (!packWriter->is_open())
+        {
+            cout << "Error: Could not create output pack: " << _output_pack << endl;
+            return 1;
+        }
+        cout << "Appending resized images to pack: " << _output_pack << " (index: " << _output_pack << ".idx)" << endl;
+    }
+    else
+    {
+        cout << "Moving resized images to output directory: " << _outdir << endl;
+    }
     cout << "Using " << _threads << " threads for processing." << endl;
 
+    std::unique_ptr<ReportWriter> reportWriter;
+    if (!_report.empty())
+    {
+        reportWriter = std::make_unique<ReportWriter>(_report);
+        if (!reportWriter->is_open())
+        {
+            cout << "Error: Could not create report file: " << _report << endl;
+            return 1;
+        }
+        cout << "Writing per-file report to: " << _report << endl;
+    }
+
+    std::unique_ptr<ResultCache> resultCache;
+    if (!_cache_dir.empty())
+    {
+        resultCache = std::make_unique<ResultCache>(_cache_dir, (uint64_t)_cache_max_mb * 1024 * 1024);
+        if (!resultCache->is_open())
+        {
+            cout << "Error: Could not open cache directory: " << _cache_dir << endl;
+            return 1;
+        }
+        cout << "Using result cache: " << _cache_dir << " (" << _cache_max_mb << " MB)" << endl;
+    }
+
+    // Each thread fetches its next job either from the tar reader queue or by a thread-safe unique index
+    auto next_job = [&](ImageJob &job) -> bool
+    {
+        if (tarReader)
+            return inputQueue.pop(job);
+
+        unsigned int index = fileIndex.fetch_add(1);
+        if (index >= allImgFiles.size())
+            return false;
+
+        job.name = allImgFiles[index];
+        job.data.clear();
+        job.in_memory = false;
+        return true;
+    };
+
+    // Decode from memory, resize, and hand the encoded bytes to the tar writer or the output directory
+    auto process_stream_job = [&](ImageJob &job, std::vector<unsigned char> &output_bytes, ResizeResult &result)
+    {
+        result.input_path = job.name;
+        if (!job.in_memory)
+        {
+            StageTimer read_timer(STAGE_READ);
+            const bool loaded = ReadFileBytes(job.name, job.data);
+            result.stage_ns[STAGE_READ] = read_timer.stop();
+            if (!loaded)
+            {
+                cout << "Failed to load image: " << job.name << endl;
+                LocalStats().failures++;
+                result.status = RESIZE_READ_FAILED;
+                return;
+            }
+        }
+
+        const string extension = std::filesystem::path(job.name).extension().string();
+        if (!CachedResizeImageBuffer(resultCache.get(), job.data.data(), job.data.size(), extension, options, output_bytes,
+                                     job.name, &result))
+            return;
+
+        // directory inputs are flattened like the regular mode, archive members keep their folders
+        string relative = OutputFileName(job.name, options);
+        if (job.in_memory)
+        {
+            relative = SafeMemberPath((std::filesystem::path(job.name).parent_path() / relative).generic_string());
+            if (relative.empty())
+            {
+                cout << "Skipping unsafe archive member name: " << job.name << endl;
+                result.status = RESIZE_WRITE_FAILED;
+                return;
+            }
+        }
+
+        if (tarWriter)
+        {
+            // written later by the tar writer thread, so there is no write time to report here
+            result.output_path = relative;
+            outputQueue.push(TarMember{relative, std::move(output_bytes)});
+            output_bytes = {};
+            return;
+        }
+
+        StageTimer write_timer(STAGE_WRITE);
+        if (packWriter)
+        {
+            result.output_path = relative;
+            if (!packWriter->append(relative, output_bytes.data(), output_bytes.size(),
+                                    result.output_width, result.output_height, result.channels))
+            {
+                cout << "ERROR **** Failed to append to pack: " << relative << endl;
+                LocalStats().failures++;
+                result.status = RESIZE_WRITE_FAILED;
+            }
+            result.stage_ns[STAGE_WRITE] = write_timer.stop();
+            return;
+        }
+
+        const std::filesystem::path outputFile = std::filesystem::path(_outdir) / relative;
+        result.output_path = outputFile.string();
+        std::filesystem::create_directories(outputFile.parent_path());
+        if (!WriteFileBytes(outputFile.string(), output_bytes.data(), output_bytes.size()))
+        {
+            cout << "ERROR **** Failed to write image: " << outputFile.string() << endl;
+            LocalStats().failures++;
+            result.status = RESIZE_WRITE_FAILED;
+        }
+        result.stage_ns[STAGE_WRITE] = write_timer.stop();
+    };
+
     // Lamda function. Pass referecne to local varriables as needed
-    auto resize_img_processor = [&fileIndex, &allImgFiles, &_outdir, &_size, &_quality, &processedFileCount, &_width, &_height]()
+    auto resize_img_processor = [&]()
     {
+        ImageJob job;
+        std::vector<unsigned char> output_bytes;
+        TraceSetThreadName("worker");
+
         // Thread will run forever until all files are processed, either by this thread or others
-        while (true)
+        while (next_job(job))
         {
-            // Each thread will fetch a thread-safe unique index to process
-            int index = fileIndex.fetch_add(1);
-            if (index >= allImgFiles.size())
+            TraceScope file_scope("file", job.name);
+            ResizeResult result;
+            if (!tarReader && !tarWriter && !packWriter)
             {
-                break;
+                result = ResizeImage(job.name, _outdir, options, resultCache.get());
             }
-
-            ResizeImage(allImgFiles[index], _outdir, _size, _quality, _width, _height);
+            else
+            {
+                try
+                {
+                    process_stream_job(job, output_bytes, result);
+                }
+                catch (const std::exception &e)
+                {
+                    cout << "Exception occurred while processing image: " << job.name << ". Error: " << e.what() << endl;
+                    result.status = RESIZE_EXCEPTION;
+                }
+            }
+            if (reportWriter)
+                reportWriter->submit(result);
             processedFileCount++;
         }
     };
 
-    // Lamda function for monitoring progress
-    auto monitor_worker = [&processedFileCount, &originalFileCount]()
+    // Lamda function for monitoring progress, streamed inputs have no known total
+    auto monitor_worker = [&processedFileCount, &originalFileCount, &workersDone, &tarReader]()
     {
-        unsigned short bar_width = 70;
+        const int total = tarReader ? 0 : (int)originalFileCount;
+        TraceSetThreadName("monitor");
 
-        while (processedFileCount < originalFileCount)
+        while (!workersDone)
         {
-            print_progress(processedFileCount, originalFileCount);
+            {
+                TraceScope tick_scope("progress");
+                print_progress(processedFileCount, total);
+            }
 
             std::this_thread::sleep_for(std::chrono::milliseconds(40));
         }
 
         // Print final progress as 100%
-        print_progress(processedFileCount, originalFileCount);
+        print_progress(processedFileCount, total);
         cout << endl << endl;
     };
 
+    // Single writer thread appends every encoded result to the output archive in arrival order
+    auto tar_writer_worker = [&tarWriter, &outputQueue]()
+    {
+        TarMember member;
+        TraceSetThreadName("tar writer");
+        while (outputQueue.pop(member))
+        {
+            StageTimer write_timer(STAGE_WRITE);
+            if (!tarWriter->append(member.name, member.data.data(), member.data.size()))
+            {
+                cout << "ERROR **** Failed to write tar member: " << member.name << endl;
+                LocalStats().failures++;
+            }
+        }
+    };
+
     std::thread monitor_thread = std::thread(monitor_worker);
 
+    std::thread writer_thread;
+    if (tarWriter)
+        writer_thread = std::thread(tar_writer_worker);
+
     // Create and launch threads
     std::vector<std::thread> threads;
     threads.reserve(_threads);
@@ -188,18 +721,78 @@ int main(int argc, char *argv[], char *envp[])
         threads.emplace_back(resize_img_processor); // adds the worker function directly to the vector without extra copy
     }
 
+    // The main thread streams the input archive while the workers run
+    if (tarReader)
+    {
+        TarMember member;
+        while (true)
+        {
+            {
+                StageTimer read_timer(STAGE_READ);
+                if (!tarReader->next(member))
+                    break;
+            }
+
+            const string filename = std::filesystem::path(member.name).filename().string();
+            if (!_imgname.empty() ? filename != _imgname : !IsSupportedImage(member.name))
+                continue;
+
+            inputQueue.push(ImageJob{std::move(member.name), std::move(member.data), true});
+            member = {};
+        }
+        if (!tarReader->error().empty())
+        {
+            cout << "Error reading tar archive " << _input_tar << ": " << tarReader->error() << endl;
+        }
+        inputQueue.close();
+    }
+
     // Main function waits for all threads to finish here
     for (std::thread &thread : threads)
     {
         thread.join();
     }
 
+    if (tarWriter)
+    {
+        outputQueue.close();
+        writer_thread.join();
+        if (!tarWriter->finish())
+        {
+            cout << "ERROR **** Failed to finish tar archive: " << _output_tar << endl;
+        }
+    }
+
+    if (packWriter && !packWriter->finish())
+    {
+        cout << "ERROR **** Failed to write pack index: " << _output_pack << ".idx" << endl;
+    }
+
+    if (reportWriter && !reportWriter->close())
+    {
+        cout << "ERROR **** Failed to write report: " << _report << endl;
+    }
+
+    workersDone = true;
     monitor_thread.join(); // Wait for monitor thread to finish
 
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed = end - start;
     cout << "Elapsed time: " << elapsed.count() << " seconds." << endl;
     cout << "ImageCompressCpp - completed processing " << processedFileCount << " files." << endl;
+    if (resultCache)
+        cout << "Result cache: " << resultCache->summary() << endl;
+
+    if (_stats)
+        PrintStatsSummary(CollectStats(), elapsed.count());
+
+    if (!_trace.empty())
+    {
+        if (TraceWrite(_trace))
+            cout << "Trace written to " << _trace << " (open in chrome://tracing or ui.perfetto.dev)" << endl;
+        else
+            cout << "ERROR **** Failed to write trace: " << _trace << endl;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
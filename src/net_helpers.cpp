@@ -0,0 +1,170 @@
+#include "net_helpers.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+bool SendAll(int fd, const void *data, size_t length)
+{
+    const char *bytes = static_cast<const char *>(data);
+    while (length > 0)
+    {
+        ssize_t sent = ::send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+bool SocketReader::fill()
+{
+    if (begin_ > 0)
+    {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+    }
+    if (end_ == buffer_.size())
+        buffer_.resize(buffer_.size() * 2);
+
+    while (true)
+    {
+        ssize_t n = ::recv(fd_, buffer_.data() + end_, buffer_.size() - end_, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        end_ += (size_t)n;
+        return true;
+    }
+}
+
+bool SocketReader::read_line(std::string &line, size_t max_length)
+{
+    size_t scanned = 0; // bytes after begin_ already searched for a newline
+    while (true)
+    {
+        const char *start = buffer_.data() + begin_;
+        const void *newline = std::memchr(start + scanned, '\n', end_ - begin_ - scanned);
+        if (newline != nullptr)
+        {
+            size_t length = static_cast<const char *>(newline) - start;
+            line.assign(start, length);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            begin_ += length + 1;
+            return true;
+        }
+
+        scanned = end_ - begin_;
+        if (scanned > max_length || !fill())
+            return false;
+    }
+}
+
+bool SocketReader::read_exact(std::vector<unsigned char> &data, size_t length)
+{
+    data.resize(length);
+    size_t done = 0;
+
+    // whatever is already buffered first, then straight from the socket
+    size_t buffered = end_ - begin_ < length ? end_ - begin_ : length;
+    std::memcpy(data.data(), buffer_.data() + begin_, buffered);
+    begin_ += buffered;
+    done += buffered;
+
+    while (done < length)
+    {
+        ssize_t n = ::recv(fd_, data.data() + done, length - done, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += (size_t)n;
+    }
+    return true;
+}
+#endif
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+std::string PercentDecode(const std::string &value, bool plus_as_space)
+{
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        if (value[i] == '%' && i + 2 < value.size() && hex_value(value[i + 1]) >= 0 && hex_value(value[i + 2]) >= 0)
+        {
+            decoded += (char)(hex_value(value[i + 1]) * 16 + hex_value(value[i + 2]));
+            i += 2;
+        }
+        else if (value[i] == '+' && plus_as_space)
+            decoded += ' ';
+        else
+            decoded += value[i];
+    }
+    return decoded;
+}
+
+std::string PercentEncode(const std::string &value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string encoded;
+    encoded.reserve(value.size());
+    for (unsigned char c : value)
+    {
+        if (c <= ' ' || c == '%' || c == '&' || c == '=' || c == '+' || c == 0x7f)
+        {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 15];
+        }
+        else
+            encoded += (char)c;
+    }
+    return encoded;
+}
+
+std::map<std::string, std::string> ParseKeyValues(const std::string &text, char separator)
+{
+    std::map<std::string, std::string> values;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find(separator, pos);
+        if (end == std::string::npos)
+            end = text.size();
+
+        const std::string pair = text.substr(pos, end - pos);
+        const size_t equals = pair.find('=');
+        if (!pair.empty())
+        {
+            if (equals == std::string::npos)
+                values[PercentDecode(pair, separator == '&')] = "";
+            else
+                values[PercentDecode(pair.substr(0, equals), separator == '&')] = PercentDecode(pair.substr(equals + 1), separator == '&');
+        }
+        pos = end + 1;
+    }
+    return values;
+}
@@ -0,0 +1,279 @@
+#include "pack_store.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char PACK_MAGIC[8] = {'I', 'C', 'P', 'A', 'C', 'K', '1', '\0'};
+
+PackFormat PackFormatFromName(const std::string &name)
+{
+    const std::string extension = std::filesystem::path(name).extension().string();
+    if (extension == ".jpg" || extension == ".jpeg")
+        return PACK_FORMAT_JPEG;
+    if (extension == ".png")
+        return PACK_FORMAT_PNG;
+    return PACK_FORMAT_UNKNOWN;
+}
+
+const char *PackFormatName(uint8_t format)
+{
+    switch (format)
+    {
+    case PACK_FORMAT_JPEG:
+        return "jpeg";
+    case PACK_FORMAT_PNG:
+        return "png";
+    default:
+        return "unknown";
+    }
+}
+
+// --- PackWriter ---
+
+PackWriter::PackWriter(const std::string &path) : path_(path)
+{
+#ifdef _WIN32
+    file_ = std::fopen(path.c_str(), "wb");
+#else
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+PackWriter::~PackWriter()
+{
+    finish();
+#ifdef _WIN32
+    if (file_ != nullptr)
+        std::fclose(file_);
+#else
+    if (fd_ >= 0)
+        ::close(fd_);
+#endif
+}
+
+bool PackWriter::is_open() const
+{
+#ifdef _WIN32
+    return file_ != nullptr;
+#else
+    return fd_ >= 0;
+#endif
+}
+
+bool PackWriter::append(const std::string &name, const unsigned char *data, size_t length, int width, int height, int channels)
+{
+    if (!is_open() || finished_)
+        return false;
+
+    const uint64_t offset = next_offset_.fetch_add(length);
+
+#ifdef _WIN32
+    {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        if (_fseeki64(file_, (long long)offset, SEEK_SET) != 0 || std::fwrite(data, 1, length, file_) != length)
+            return false;
+    }
+#else
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t n = ::pwrite(fd_, data + written, length - written, (off_t)(offset + written));
+        if (n <= 0)
+            return false;
+        written += (size_t)n;
+    }
+#endif
+
+    PackEntry entry;
+    entry.name = name;
+    entry.offset = offset;
+    entry.length = length;
+    entry.width = (uint32_t)width;
+    entry.height = (uint32_t)height;
+    entry.channels = (uint8_t)channels;
+    entry.format = PackFormatFromName(name);
+
+    std::lock_guard<std::mutex> lock(entries_mutex_);
+    entries_.push_back(std::move(entry));
+    return true;
+}
+
+bool PackWriter::finish()
+{
+    if (!is_open() || finished_)
+        return false;
+    finished_ = true;
+
+    std::sort(entries_.begin(), entries_.end(), [](const PackEntry &a, const PackEntry &b) { return a.name < b.name; });
+
+    PackIndexHeader header = {};
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.count = entries_.size();
+    header.names_offset = sizeof(PackIndexHeader) + entries_.size() * sizeof(PackIndexRecord);
+
+    std::vector<PackIndexRecord> records(entries_.size());
+    std::string names;
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        const PackEntry &entry = entries_[i];
+        PackIndexRecord &record = records[i];
+        record = {};
+        record.offset = entry.offset;
+        record.length = entry.length;
+        record.name_offset = names.size();
+        record.name_length = (uint32_t)entry.name.size();
+        record.width = entry.width;
+        record.height = entry.height;
+        record.channels = entry.channels;
+        record.format = entry.format;
+        names += entry.name;
+    }
+
+    FILE *index = std::fopen((path_ + ".idx").c_str(), "wb");
+    if (index == nullptr)
+        return false;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, index) == 1;
+    ok = ok && (records.empty() || std::fwrite(records.data(), sizeof(PackIndexRecord), records.size(), index) == records.size());
+    ok = ok && (names.empty() || std::fwrite(names.data(), 1, names.size(), index) == names.size());
+    ok = (std::fclose(index) == 0) && ok;
+
+#ifdef _WIN32
+    ok = (std::fflush(file_) == 0) && ok;
+#else
+    ok = (::fsync(fd_) == 0) && ok;
+#endif
+    return ok;
+}
+
+// --- PackReader ---
+
+PackReader::PackReader(const std::string &path)
+{
+    const std::string index_path = path + ".idx";
+
+#ifdef _WIN32
+    FILE *index = std::fopen(index_path.c_str(), "rb");
+    if (index == nullptr)
+        return;
+    std::error_code ec;
+    index_copy_.resize((size_t)std::filesystem::file_size(index_path, ec));
+    bool ok = !ec && std::fread(index_copy_.data(), 1, index_copy_.size(), index) == index_copy_.size();
+    std::fclose(index);
+    blob_ = std::fopen(path.c_str(), "rb");
+    if (!ok || blob_ == nullptr)
+        return;
+    index_ = index_copy_.data();
+    index_size_ = index_copy_.size();
+#else
+    int index_fd = ::open(index_path.c_str(), O_RDONLY);
+    if (index_fd < 0)
+        return;
+
+    struct stat st;
+    if (::fstat(index_fd, &st) != 0 || st.st_size < (off_t)sizeof(PackIndexHeader))
+    {
+        ::close(index_fd);
+        return;
+    }
+
+    void *mapped = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, index_fd, 0);
+    ::close(index_fd);
+    if (mapped == MAP_FAILED)
+        return;
+
+    index_ = static_cast<const unsigned char *>(mapped);
+    index_size_ = (size_t)st.st_size;
+
+    blob_fd_ = ::open(path.c_str(), O_RDONLY);
+    if (blob_fd_ < 0)
+        return;
+#endif
+
+    if (index_size_ < sizeof(PackIndexHeader))
+        return;
+
+    PackIndexHeader header;
+    std::memcpy(&header, index_, sizeof(header));
+    if (std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 ||
+        header.names_offset != sizeof(PackIndexHeader) + header.count * sizeof(PackIndexRecord) ||
+        header.names_offset > index_size_)
+        return;
+
+    count_ = header.count;
+    names_ = reinterpret_cast<const char *>(index_ + header.names_offset);
+    records_ = reinterpret_cast<const PackIndexRecord *>(index_ + sizeof(PackIndexHeader));
+}
+
+PackReader::~PackReader()
+{
+#ifdef _WIN32
+    if (blob_ != nullptr)
+        std::fclose(blob_);
+#else
+    if (index_ != nullptr)
+        ::munmap(const_cast<unsigned char *>(index_), index_size_);
+    if (blob_fd_ >= 0)
+        ::close(blob_fd_);
+#endif
+}
+
+bool PackReader::find(const std::string &name, PackEntry &entry) const
+{
+    if (!is_open())
+        return false;
+
+    const size_t names_size = index_size_ - (size_t)(reinterpret_cast<const unsigned char *>(names_) - index_);
+    auto record_name = [this, names_size](const PackIndexRecord &record) -> std::string_view
+    {
+        if (record.name_offset + record.name_length > names_size)
+            return {};
+        return std::string_view(names_ + record.name_offset, record.name_length);
+    };
+
+    // records are sorted by name, plain binary search over the mapped array
+    const PackIndexRecord *first = records_;
+    const PackIndexRecord *last = records_ + count_;
+    const PackIndexRecord *found = std::lower_bound(first, last, std::string_view(name),
+                                                    [&record_name](const PackIndexRecord &record, std::string_view key)
+                                                    { return record_name(record) < key; });
+    if (found == last || record_name(*found) != name)
+        return false;
+
+    entry.name = name;
+    entry.offset = found->offset;
+    entry.length = found->length;
+    entry.width = found->width;
+    entry.height = found->height;
+    entry.channels = found->channels;
+    entry.format = found->format;
+    return true;
+}
+
+bool PackReader::read(const PackEntry &entry, std::vector<unsigned char> &data) const
+{
+    data.resize((size_t)entry.length);
+
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(blob_mutex_);
+    return _fseeki64(blob_, (long long)entry.offset, SEEK_SET) == 0 &&
+           std::fread(data.data(), 1, data.size(), blob_) == data.size();
+#else
+    size_t done = 0;
+    while (done < data.size())
+    {
+        ssize_t n = ::pread(blob_fd_, data.data() + done, data.size() - done, (off_t)(entry.offset + done));
+        if (n <= 0)
+            return false;
+        done += (size_t)n;
+    }
+    return true;
+#endif
+}
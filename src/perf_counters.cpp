@@ -0,0 +1,186 @@
+#include "perf_counters.h"
+
+bool g_perf_enabled = false;
+
+const char *PerfCounterName(PerfCounter counter)
+{
+    switch (counter)
+    {
+    case PERF_CYCLES:
+        return "cycles";
+    case PERF_INSTRUCTIONS:
+        return "instructions";
+    case PERF_LLC_MISSES:
+        return "llc-misses";
+    case PERF_BRANCH_MISSES:
+        return "branch-misses";
+    default:
+        return "?";
+    }
+}
+
+void PerfCountersAccumulate(const PerfSample &start, const PerfSample &end, uint64_t totals[PERF_COUNTER_COUNT])
+{
+    if (!start.valid || !end.valid)
+        return;
+
+    const uint64_t enabled = end.time_enabled - start.time_enabled;
+    const uint64_t running = end.time_running - start.time_running;
+    const double scale = running > 0 && running < enabled ? (double)enabled / running : 1.0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        totals[i] += (uint64_t)((end.values[i] - start.values[i]) * scale);
+}
+
+#ifndef __linux__
+
+bool PerfCountersEnable(std::string &reason)
+{
+    reason = "hardware counters need perf_event_open and are only supported on Linux";
+    return false;
+}
+
+bool PerfCounterAvailable(PerfCounter)
+{
+    return false;
+}
+
+void PerfCountersRead(PerfSample &sample)
+{
+    sample.valid = false;
+}
+
+#else
+
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static bool counter_available[PERF_COUNTER_COUNT] = {};
+
+static const struct
+{
+    uint32_t type;
+    uint64_t config;
+} counter_events[PERF_COUNTER_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// One group per thread, the leader's read returns every member at once
+struct ThreadCounters
+{
+    bool opened = false;
+    int leader = -1;
+    int fds[PERF_COUNTER_COUNT] = {-1, -1, -1, -1};
+    int slot[PERF_COUNTER_COUNT] = {-1, -1, -1, -1}; // position in the group read
+
+    ~ThreadCounters()
+    {
+        for (int fd : fds)
+            if (fd >= 0)
+                ::close(fd);
+    }
+};
+
+static int open_counter(PerfCounter counter, int group_fd)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter_events[counter].type;
+    attr.config = counter_events[counter].config;
+    attr.disabled = group_fd < 0 ? 1 : 0;
+    attr.exclude_kernel = 1; // allowed up to perf_event_paranoid 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)::syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+// Opens the group for the calling thread. The leader is cycles, without it nothing is usable.
+// The probe opens everything it can and records what worked, later threads only open those.
+static bool open_group(ThreadCounters &counters, bool probing)
+{
+    counters.opened = true;
+    int next_slot = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+    {
+        if (!probing && !counter_available[i])
+            continue;
+
+        const int fd = open_counter((PerfCounter)i, counters.leader);
+        if (fd < 0)
+        {
+            if (i == PERF_CYCLES)
+                return false;
+            continue;
+        }
+        if (i == PERF_CYCLES)
+            counters.leader = fd;
+        counters.fds[i] = fd;
+        counters.slot[i] = next_slot++;
+        if (probing)
+            counter_available[i] = true;
+    }
+
+    ::ioctl(counters.leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(counters.leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+static ThreadCounters &local_counters()
+{
+    static thread_local ThreadCounters counters;
+    return counters;
+}
+
+bool PerfCountersEnable(std::string &reason)
+{
+    if (!open_group(local_counters(), true))
+    {
+        const int error = errno;
+        reason = std::string("perf_event_open failed: ") + std::strerror(error);
+        if (error == EACCES || error == EPERM)
+            reason += " (check /proc/sys/kernel/perf_event_paranoid or CAP_PERFMON)";
+        else if (error == ENOENT || error == EOPNOTSUPP)
+            reason += " (no hardware PMU, common inside VMs)";
+        return false;
+    }
+    g_perf_enabled = true;
+    return true;
+}
+
+bool PerfCounterAvailable(PerfCounter counter)
+{
+    return counter_available[counter];
+}
+
+void PerfCountersRead(PerfSample &sample)
+{
+    ThreadCounters &counters = local_counters();
+    if (!counters.opened)
+        open_group(counters, false);
+
+    sample.valid = false;
+    if (counters.leader < 0)
+        return;
+
+    // nr, time_enabled, time_running, then one value per group member
+    uint64_t buffer[3 + PERF_COUNTER_COUNT];
+    const ssize_t length = ::read(counters.leader, buffer, sizeof(buffer));
+    if (length < (ssize_t)(3 * sizeof(uint64_t)))
+        return;
+
+    const uint64_t members = buffer[0];
+    sample.time_enabled = buffer[1];
+    sample.time_running = buffer[2];
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        sample.values[i] = counters.slot[i] >= 0 && (uint64_t)counters.slot[i] < members ? buffer[3 + counters.slot[i]] : 0;
+    sample.valid = true;
+}
+
+#endif
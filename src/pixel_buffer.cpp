@@ -0,0 +1,111 @@
+#include "pixel_buffer.h"
+#include "alloc_tracker.h"
+
+size_t PixelBuffer::total_bytes() const
+{
+    size_t total = 0;
+    for (int i = 0; i < planes(); ++i)
+        total += plane_bytes(i);
+    return total;
+}
+
+unsigned char *PixelBuffer::plane(int plane) const
+{
+    unsigned char *start = data;
+    for (int i = 0; i < plane; ++i)
+        start += plane_bytes(i);
+    return start;
+}
+
+PixelBuffer MakePixelBuffer(PixelLayout layout, int width, int height, int channels)
+{
+    PixelBuffer buffer;
+    buffer.layout = layout;
+    buffer.channels = channels;
+    for (int i = 0; i < 4; ++i)
+    {
+        buffer.width[i] = width;
+        buffer.height[i] = height;
+    }
+    return buffer;
+}
+
+bool AllocPixels(PixelBuffer &buffer)
+{
+    buffer.data = (unsigned char *)AllocTrackedMalloc(buffer.total_bytes());
+    return buffer.data != nullptr;
+}
+
+void FreePixels(PixelBuffer &buffer)
+{
+    if (buffer.data != nullptr)
+        AllocTrackedFree(buffer.data);
+    buffer.data = nullptr;
+}
+
+// Fixed channel counts so the per-pixel loops unroll
+template <int C>
+static void split_channels(const unsigned char *src, size_t count, unsigned char *dst)
+{
+    for (size_t i = 0; i < count; ++i)
+        for (int c = 0; c < C; ++c)
+            dst[c * count + i] = src[i * C + c];
+}
+
+template <int C>
+static void merge_channels(const unsigned char *src, size_t count, unsigned char *dst)
+{
+    for (size_t i = 0; i < count; ++i)
+        for (int c = 0; c < C; ++c)
+            dst[i * C + c] = src[c * count + i];
+}
+
+PixelBuffer DeinterleavePixels(const PixelBuffer &interleaved)
+{
+    PixelBuffer planar = MakePixelBuffer(PIXELS_PLANAR, interleaved.width[0], interleaved.height[0], interleaved.channels);
+    if (!AllocPixels(planar))
+        return planar;
+
+    const size_t count = (size_t)interleaved.width[0] * interleaved.height[0];
+    switch (interleaved.channels)
+    {
+    case 1:
+        split_channels<1>(interleaved.data, count, planar.data);
+        break;
+    case 2:
+        split_channels<2>(interleaved.data, count, planar.data);
+        break;
+    case 3:
+        split_channels<3>(interleaved.data, count, planar.data);
+        break;
+    default:
+        split_channels<4>(interleaved.data, count, planar.data);
+        break;
+    }
+    return planar;
+}
+
+PixelBuffer InterleavePixels(const PixelBuffer &planar)
+{
+    PixelBuffer interleaved = MakePixelBuffer(PIXELS_INTERLEAVED, planar.width[0], planar.height[0], planar.channels);
+    if (!AllocPixels(interleaved))
+        return interleaved;
+
+    const size_t count = (size_t)planar.width[0] * planar.height[0];
+    switch (planar.channels)
+    {
+    case 1:
+        merge_channels<1>(planar.data, count, interleaved.data);
+        break;
+    case 2:
+        merge_channels<2>(planar.data, count, interleaved.data);
+        break;
+    case 3:
+        merge_channels<3>(planar.data, count, interleaved.data);
+        break;
+    default:
+        merge_channels<4>(planar.data, count, interleaved.data);
+        break;
+    }
+    return interleaved;
+}
@@ -0,0 +1,261 @@
+#include "planner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include "file_helpers.h"
+#include "stb_image.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// Rates of one 2020s desktop core with this code, used until --autotune measures the real host
+static CostModel builtin_model()
+{
+    CostModel model;
+    model.decode_jpeg_mps = 80;
+    model.decode_png_mps = 50;
+    model.resize_mps = 250;
+    model.encode_jpeg_mps = 60;
+    model.encode_png_mps = 20;
+    model.jpeg_bytes_per_pixel = 0.6;
+    model.png_bytes_per_pixel = 2.0;
+    model.jpeg_quality = 80;
+    model.peak_bytes_per_pixel = 4.5;
+    return model;
+}
+
+// Typical JPEG size relative to quality 80 for photographic content, interpolated between points
+static double jpeg_size_factor(int quality)
+{
+    static const double points[][2] = {{1, 0.15}, {10, 0.25}, {30, 0.45}, {50, 0.6}, {70, 0.8},
+                                       {80, 1.0}, {90, 1.5}, {95, 2.2}, {100, 4.0}};
+    quality = std::min(100, std::max(1, quality));
+    for (size_t i = 1; i < sizeof(points) / sizeof(points[0]); ++i)
+    {
+        if (quality <= points[i][0])
+        {
+            const double t = (quality - points[i - 1][0]) / (points[i][0] - points[i - 1][0]);
+            return points[i - 1][1] + t * (points[i][1] - points[i - 1][1]);
+        }
+    }
+    return points[sizeof(points) / sizeof(points[0]) - 1][1];
+}
+
+static bool is_png(const string &extension)
+{
+    return extension == ".png";
+}
+
+CostModel CalibrateCostModel(const std::vector<SampleImage> &samples, const ResizeOptions &options)
+{
+    double decode_s[2] = {}, decode_mp[2] = {}, encode_s[2] = {}, encode_mp[2] = {}, out_bytes[2] = {};
+    double resize_s = 0, resize_mp = 0, peak_bytes = 0, peak_mp = 0;
+
+    std::vector<unsigned char> output;
+    for (const SampleImage &sample : samples)
+    {
+        ResizeResult result;
+        if (!ResizeImageBuffer(sample.bytes.data(), sample.bytes.size(), sample.extension, options, output, sample.name, &result))
+            continue;
+        // unchanged sources cost nothing to measure, they would make every rate look infinite
+        if (result.passthrough)
+            continue;
+
+        const int format = is_png(sample.extension) ? 1 : 0;
+        const double in_mp = (double)result.input_width * result.input_height / 1e6;
+        const double out_mp = (double)result.output_width * result.output_height / 1e6;
+        decode_s[format] += result.stage_ns[STAGE_DECODE] / 1e9;
+        decode_mp[format] += in_mp;
+        encode_s[format] += result.stage_ns[STAGE_ENCODE] / 1e9;
+        encode_mp[format] += out_mp;
+        out_bytes[format] += result.bytes_out;
+        if (result.stage_ns[STAGE_RESIZE] > 0)
+        {
+            resize_s += result.stage_ns[STAGE_RESIZE] / 1e9;
+            resize_mp += in_mp;
+        }
+
+        peak_mp += in_mp;
+        peak_bytes += std::max({result.peak_bytes[STAGE_DECODE], result.peak_bytes[STAGE_RESIZE], result.peak_bytes[STAGE_ENCODE]});
+    }
+
+    // formats missing from the sample keep the built-in rates
+    CostModel model = builtin_model();
+    auto rate = [](double mp, double seconds, double fallback) { return mp > 0 && seconds > 0 ? mp / seconds : fallback; };
+    model.decode_jpeg_mps = rate(decode_mp[0], decode_s[0], model.decode_jpeg_mps);
+    model.decode_png_mps = rate(decode_mp[1], decode_s[1], model.decode_png_mps);
+    model.encode_jpeg_mps = rate(encode_mp[0], encode_s[0], model.encode_jpeg_mps);
+    model.encode_png_mps = rate(encode_mp[1], encode_s[1], model.encode_png_mps);
+    model.resize_mps = rate(resize_mp, resize_s, model.resize_mps);
+    if (encode_mp[0] > 0)
+    {
+        model.jpeg_bytes_per_pixel = out_bytes[0] / (encode_mp[0] * 1e6);
+        model.jpeg_quality = options.quality;
+    }
+    if (encode_mp[1] > 0)
+        model.png_bytes_per_pixel = out_bytes[1] / (encode_mp[1] * 1e6);
+    // pixel-weighted, so the fixed overhead of tiny images doesn't inflate the estimate for big ones
+    if (peak_mp > 0)
+        model.peak_bytes_per_pixel = peak_bytes / (peak_mp * 1e6);
+    return model;
+}
+
+// What one thread learned from the headers it probed
+struct PlanTotals
+{
+    uint64_t files[2] = {};
+    uint64_t unreadable = 0;
+    uint64_t input_bytes = 0;
+    double input_mp = 0;
+    double output_mp = 0;
+    double cpu_seconds[STAGE_COUNT] = {};
+    double output_bytes = 0;
+    double slowest_image_seconds = 0;
+    std::vector<double> largest_peaks; // the biggest per-image peaks, at most `threads` of them
+
+    void merge(const PlanTotals &other, size_t keep)
+    {
+        for (int i = 0; i < 2; ++i)
+            files[i] += other.files[i];
+        unreadable += other.unreadable;
+        input_bytes += other.input_bytes;
+        input_mp += other.input_mp;
+        output_mp += other.output_mp;
+        for (int i = 0; i < STAGE_COUNT; ++i)
+            cpu_seconds[i] += other.cpu_seconds[i];
+        output_bytes += other.output_bytes;
+        slowest_image_seconds = std::max(slowest_image_seconds, other.slowest_image_seconds);
+        for (double peak : other.largest_peaks)
+            add_peak(peak, keep);
+    }
+
+    void add_peak(double peak, size_t keep)
+    {
+        if (largest_peaks.size() < keep)
+        {
+            largest_peaks.push_back(peak);
+            std::push_heap(largest_peaks.begin(), largest_peaks.end(), std::greater<double>());
+        }
+        else if (keep > 0 && peak > largest_peaks.front())
+        {
+            std::pop_heap(largest_peaks.begin(), largest_peaks.end(), std::greater<double>());
+            largest_peaks.back() = peak;
+            std::push_heap(largest_peaks.begin(), largest_peaks.end(), std::greater<double>());
+        }
+    }
+};
+
+int RunPlan(const std::string &imgdir, const std::string &imgname, unsigned int threads,
+            const ResizeOptions &options, const CostModel &calibrated)
+{
+    const auto start = std::chrono::steady_clock::now();
+    threads = std::max(1u, threads);
+    const CostModel model = calibrated.calibrated() ? calibrated : builtin_model();
+
+    std::vector<string> files;
+    for (const auto &entry : std::filesystem::directory_iterator(imgdir))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        const string filepath = entry.path().string();
+        if (!imgname.empty() ? entry.path().filename() == imgname : IsSupportedImage(filepath))
+            files.push_back(filepath);
+    }
+
+    const double jpeg_bytes_per_pixel =
+        model.jpeg_bytes_per_pixel * jpeg_size_factor(options.quality) / jpeg_size_factor(model.jpeg_quality);
+
+    // header probes are I/O bound, so they run on more threads than there are cores
+    const unsigned int probe_threads = std::max(4u, std::thread::hardware_concurrency() * 2);
+    std::atomic<size_t> next{0};
+    std::vector<PlanTotals> partial(probe_threads);
+    std::vector<std::thread> probes;
+    for (unsigned int t = 0; t < probe_threads; ++t)
+    {
+        probes.emplace_back([&, t]()
+        {
+            PlanTotals &totals = partial[t];
+            for (size_t i = next++; i < files.size(); i = next++)
+            {
+                FILE *file = std::fopen(files[i].c_str(), "rb");
+                int width = 0, height = 0, channels = 0;
+                if (file == nullptr || !stbi_info_from_file(file, &width, &height, &channels) || width <= 0 || height <= 0)
+                {
+                    if (file != nullptr)
+                        std::fclose(file);
+                    totals.unreadable++;
+                    continue;
+                }
+                std::fseek(file, 0, SEEK_END);
+                totals.input_bytes += (uint64_t)std::ftell(file);
+                std::fclose(file);
+
+                const string extension = std::filesystem::path(files[i]).extension().string();
+                const int png = is_png(extension) ? 1 : 0;
+                int out_width, out_height;
+                ComputeOutputSize(width, height, options, out_width, out_height);
+                const double in_mp = (double)width * height / 1e6;
+                const double out_mp = (double)std::max(0, out_width) * std::max(0, out_height) / 1e6;
+
+                const double decode = in_mp / (png ? model.decode_png_mps : model.decode_jpeg_mps);
+                const double resize = out_width == width && out_height == height ? 0.0 : in_mp / model.resize_mps;
+                const double encode = out_mp / (png ? model.encode_png_mps : model.encode_jpeg_mps);
+
+                totals.files[png]++;
+                totals.input_mp += in_mp;
+                totals.output_mp += out_mp;
+                totals.cpu_seconds[STAGE_DECODE] += decode;
+                totals.cpu_seconds[STAGE_RESIZE] += resize;
+                totals.cpu_seconds[STAGE_ENCODE] += encode;
+                totals.output_bytes += out_mp * 1e6 * (png ? model.png_bytes_per_pixel : jpeg_bytes_per_pixel);
+                totals.slowest_image_seconds = std::max(totals.slowest_image_seconds, decode + resize + encode);
+                totals.add_peak(in_mp * 1e6 * model.peak_bytes_per_pixel, threads);
+            }
+        });
+    }
+    for (std::thread &probe : probes)
+        probe.join();
+
+    PlanTotals totals;
+    for (const PlanTotals &part : partial)
+        totals.merge(part, threads);
+
+    const double cpu = totals.cpu_seconds[STAGE_DECODE] + totals.cpu_seconds[STAGE_RESIZE] + totals.cpu_seconds[STAGE_ENCODE];
+    const unsigned int busy = std::min<uint64_t>(threads, std::max<uint64_t>(1, totals.files[0] + totals.files[1]));
+    // one huge image can't be split across threads, so it bounds the wall time from below
+    const double wall = std::max(cpu / std::min(busy, std::max(1u, std::thread::hardware_concurrency())), totals.slowest_image_seconds);
+    double peak_memory = (double)CurrentRssBytes();
+    for (double peak : totals.largest_peaks)
+        peak_memory += peak;
+
+    const double mb = 1024.0 * 1024.0;
+    const double probe_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char line[256];
+
+    cout << "Plan for " << imgdir << " (" << (calibrated.calibrated() ? "cost model calibrated by --autotune" : "built-in cost model, run --autotune to calibrate") << ")" << endl;
+    std::snprintf(line, sizeof(line), "files:        %llu JPEG, %llu PNG, %llu unreadable, %.1f MB in",
+                  (unsigned long long)totals.files[0], (unsigned long long)totals.files[1],
+                  (unsigned long long)totals.unreadable, totals.input_bytes / mb);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "pixels:       %.1f MP in, %.1f MP out", totals.input_mp, totals.output_mp);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "cpu time:     decode %.1f s, resize %.1f s, encode %.1f s",
+                  totals.cpu_seconds[STAGE_DECODE], totals.cpu_seconds[STAGE_RESIZE], totals.cpu_seconds[STAGE_ENCODE]);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "wall time:    ~%.1f s with %u threads (I/O not included)", wall, threads);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "peak memory:  ~%.1f MB (the %zu largest images in flight at once)", peak_memory / mb,
+                  totals.largest_peaks.size());
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "output:       ~%.1f MB", totals.output_bytes / mb);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "probed %zu headers in %.2f s", files.size(), probe_seconds);
+    cout << line << endl;
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "report_writer.h"
+
+// lines waiting for the writer thread before submit() starts blocking
+static const size_t REPORT_QUEUE_LINES = 16384;
+
+std::string JsonEscape(const std::string &text)
+{
+    std::string escaped;
+    escaped.reserve(text.size() + 8);
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += (char)c;
+        }
+        else if (c < 0x20)
+        {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        }
+        else
+            escaped += (char)c;
+    }
+    return escaped;
+}
+
+std::string FormatReportLine(const ResizeResult &result)
+{
+    char numbers[768];
+    std::snprintf(numbers, sizeof(numbers),
+                  "\"input_width\":%d,\"input_height\":%d,\"output_width\":%d,\"output_height\":%d,\"channels\":%d,"
+                  "\"bytes_in\":%llu,\"bytes_out\":%llu,\"ratio\":%.4f,"
+                  "\"read_ms\":%.3f,\"decode_ms\":%.3f,\"resize_ms\":%.3f,\"encode_ms\":%.3f,\"write_ms\":%.3f,"
+                  "\"decode_peak_bytes\":%llu,\"resize_peak_bytes\":%llu,\"encode_peak_bytes\":%llu,\"cache_hit\":%s,\"passthrough\":%s,\"upscale_avoided\":%s,\"kept_source\":%s",
+                  result.input_width, result.input_height, result.output_width, result.output_height, result.channels,
+                  (unsigned long long)result.bytes_in, (unsigned long long)result.bytes_out,
+                  result.bytes_in ? (double)result.bytes_out / result.bytes_in : 0.0,
+                  result.stage_ns[STAGE_READ] / 1e6, result.stage_ns[STAGE_DECODE] / 1e6, result.stage_ns[STAGE_RESIZE] / 1e6,
+                  result.stage_ns[STAGE_ENCODE] / 1e6, result.stage_ns[STAGE_WRITE] / 1e6,
+                  (unsigned long long)result.peak_bytes[STAGE_DECODE], (unsigned long long)result.peak_bytes[STAGE_RESIZE],
+                  (unsigned long long)result.peak_bytes[STAGE_ENCODE], result.cache_hit ? "true" : "false",
+                  result.passthrough ? "true" : "false", result.upscale_avoided ? "true" : "false",
+                  result.kept_source ? "true" : "false");
+
+    return "{\"input\":\"" + JsonEscape(result.input_path) + "\",\"output\":\"" + JsonEscape(result.output_path) +
+           "\",\"status\":\"" + ResizeStatusName(result.status) + "\"," + numbers + "}";
+}
+
+ReportWriter::ReportWriter(const std::string &path) : lines_(REPORT_QUEUE_LINES)
+{
+    file_ = std::fopen(path.c_str(), "w");
+    if (file_ == nullptr)
+        return;
+
+    writer_ = std::thread([this]()
+    {
+        std::string line;
+        while (lines_.pop(line))
+        {
+            line += '\n';
+            if (std::fwrite(line.data(), 1, line.size(), file_) != line.size())
+                failed_ = true;
+        }
+    });
+}
+
+ReportWriter::~ReportWriter()
+{
+    close();
+}
+
+void ReportWriter::submit(const ResizeResult &result)
+{
+    if (file_ != nullptr && !closed_)
+        lines_.push(FormatReportLine(result));
+}
+
+bool ReportWriter::close()
+{
+    if (file_ == nullptr || closed_)
+        return !failed_;
+    closed_ = true;
+
+    lines_.close();
+    writer_.join();
+    if (std::fclose(file_) != 0)
+        failed_ = true;
+    file_ = nullptr;
+    return !failed_;
+}
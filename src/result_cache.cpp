@@ -0,0 +1,345 @@
+#include "result_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "file_helpers.h"
+
+namespace fs = std::filesystem;
+using std::string;
+
+// evict down to this fraction of the limit so a full cache doesn't evict on every store
+static const double EVICT_TARGET = 0.9;
+
+// temporaries younger than this may still be written by another process sharing the directory
+static const int STALE_TEMP_SECONDS = 3600;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3 x64 128-bit (public domain, Austin Appleby). Several GB/s, so hashing costs far
+// less than the decode it can save, and 128 bits make collisions a non-issue at any cache size.
+static void murmur3_128(const unsigned char *data, size_t length, uint64_t seed, uint64_t out[2])
+{
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = seed, h2 = seed;
+
+    const size_t blocks = length / 16;
+    for (size_t i = 0; i < blocks; ++i)
+    {
+        uint64_t k1, k2;
+        std::memcpy(&k1, data + i * 16, 8);
+        std::memcpy(&k2, data + i * 16 + 8, 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char *tail = data + blocks * 16;
+    uint64_t k1 = 0, k2 = 0;
+    switch (length & 15)
+    {
+    case 15: k2 ^= (uint64_t)tail[14] << 48; [[fallthrough]];
+    case 14: k2 ^= (uint64_t)tail[13] << 40; [[fallthrough]];
+    case 13: k2 ^= (uint64_t)tail[12] << 32; [[fallthrough]];
+    case 12: k2 ^= (uint64_t)tail[11] << 24; [[fallthrough]];
+    case 11: k2 ^= (uint64_t)tail[10] << 16; [[fallthrough]];
+    case 10: k2 ^= (uint64_t)tail[9] << 8; [[fallthrough]];
+    case 9:  k2 ^= (uint64_t)tail[8];
+             k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2; [[fallthrough]];
+    case 8:  k1 ^= (uint64_t)tail[7] << 56; [[fallthrough]];
+    case 7:  k1 ^= (uint64_t)tail[6] << 48; [[fallthrough]];
+    case 6:  k1 ^= (uint64_t)tail[5] << 40; [[fallthrough]];
+    case 5:  k1 ^= (uint64_t)tail[4] << 32; [[fallthrough]];
+    case 4:  k1 ^= (uint64_t)tail[3] << 24; [[fallthrough]];
+    case 3:  k1 ^= (uint64_t)tail[2] << 16; [[fallthrough]];
+    case 2:  k1 ^= (uint64_t)tail[1] << 8; [[fallthrough]];
+    case 1:  k1 ^= (uint64_t)tail[0];
+             k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= length; h2 ^= length;
+    h1 += h2; h2 += h1;
+    h1 = fmix64(h1); h2 = fmix64(h2);
+    h1 += h2; h2 += h1;
+    out[0] = h1;
+    out[1] = h2;
+}
+
+static int64_t now_seconds()
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static long process_id()
+{
+#ifdef _WIN32
+    return _getpid();
+#else
+    return (long)::getpid();
+#endif
+}
+
+static int64_t mtime_seconds(const fs::path &path)
+{
+    std::error_code ec;
+    const auto time = fs::last_write_time(path, ec);
+    if (ec)
+        return 0;
+    return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+}
+
+ResultCache::ResultCache(const std::string &dir, uint64_t max_bytes) : dir_(dir), max_bytes_(max_bytes)
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (!fs::is_directory(dir_, ec))
+        return;
+
+    // index what previous runs left behind, old temporaries from crashed runs are removed
+    for (auto it = fs::recursive_directory_iterator(dir_, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+    {
+        if (!it->is_regular_file(ec))
+            continue;
+        const string name = it->path().filename().string();
+        if (name.find(".tmp") != string::npos)
+        {
+            const auto modified = fs::last_write_time(it->path(), ec);
+            if (!ec && fs::file_time_type::clock::now() - modified > std::chrono::seconds(STALE_TEMP_SECONDS))
+                fs::remove(it->path(), ec);
+            continue;
+        }
+        Entry entry;
+        entry.size = it->file_size(ec);
+        entry.last_use = mtime_seconds(it->path());
+        total_bytes_ += entry.size;
+        entries_[name] = entry;
+    }
+    open_ = true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict_locked();
+}
+
+std::string ResultCache::key_for(const unsigned char *data, size_t length, const std::string &extension,
+                                 const ResizeOptions &options) const
+{
+    const string params = ProcessingKey(extension, options);
+    uint64_t content[2], settings[2];
+    murmur3_128(data, length, 0, content);
+    murmur3_128((const unsigned char *)params.data(), params.size(), content[0] ^ content[1], settings);
+
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)(content[0] ^ settings[0]),
+                  (unsigned long long)(content[1] ^ settings[1]));
+    return hex;
+}
+
+std::string ResultCache::path_for(const std::string &key, const std::string &extension) const
+{
+    return (fs::path(dir_) / key.substr(0, 2) / (key + extension)).string();
+}
+
+bool ResultCache::claim(const std::string &key, const std::string &extension)
+{
+    const string name = key + extension;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (in_flight_.count(name))
+    {
+        duplicates_++;
+        published_.wait(lock, [&]() { return in_flight_.count(name) == 0; });
+    }
+
+    bool present = entries_.count(name) > 0;
+    if (!present)
+    {
+        // another process sharing the directory may have stored it since we indexed
+        std::error_code ec;
+        const string path = path_for(key, extension);
+        const uint64_t size = fs::file_size(path, ec);
+        if (!ec)
+        {
+            entries_[name] = Entry{size, now_seconds()};
+            total_bytes_ += size;
+            present = true;
+        }
+    }
+
+    if (present)
+    {
+        hits_++;
+        return false;
+    }
+    misses_++;
+    in_flight_.insert(name);
+    return true;
+}
+
+void ResultCache::publish(const std::string &key, const std::string &extension, const unsigned char *data, size_t length)
+{
+    const string name = key + extension;
+    const fs::path path = path_for(key, extension);
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    // write then rename, so concurrent readers and other processes never see half an entry. Thread
+    // ids repeat across processes, so the pid keeps two processes' temporaries apart.
+    const fs::path temp = path.string() + ".tmp" + std::to_string(process_id()) + "-" +
+                          std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    bool stored = WriteFileBytes(temp.string(), data, length);
+    if (stored)
+    {
+        fs::rename(temp, path, ec);
+        stored = !ec;
+    }
+    if (!stored)
+        fs::remove(temp, ec);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.erase(name);
+    if (stored && entries_.count(name) == 0)
+    {
+        entries_[name] = Entry{length, now_seconds()};
+        total_bytes_ += length;
+        evict_locked();
+    }
+    published_.notify_all();
+}
+
+void ResultCache::abandon(const std::string &key, const std::string &extension)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_.erase(key + extension);
+    published_.notify_all();
+}
+
+void ResultCache::touch(const std::string &key, const std::string &extension)
+{
+    std::error_code ec;
+    fs::last_write_time(path_for(key, extension), fs::file_time_type::clock::now(), ec);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key + extension);
+    if (it != entries_.end())
+        it->second.last_use = now_seconds();
+}
+
+bool ResultCache::fetch_to_file(const std::string &key, const std::string &extension, const std::string &dest)
+{
+    if (!CloneFile(path_for(key, extension), dest))
+        return false;
+    touch(key, extension);
+    return true;
+}
+
+bool ResultCache::fetch(const std::string &key, const std::string &extension, std::vector<unsigned char> &bytes)
+{
+    if (!ReadFileBytes(path_for(key, extension), bytes))
+        return false;
+    touch(key, extension);
+    return true;
+}
+
+void ResultCache::evict_locked()
+{
+    if (total_bytes_ <= max_bytes_)
+        return;
+
+    std::vector<std::pair<int64_t, string>> by_age;
+    by_age.reserve(entries_.size());
+    for (const auto &entry : entries_)
+        if (!in_flight_.count(entry.first))
+            by_age.emplace_back(entry.second.last_use, entry.first);
+    std::sort(by_age.begin(), by_age.end());
+
+    const uint64_t target = (uint64_t)(max_bytes_ * EVICT_TARGET);
+    for (const auto &victim : by_age)
+    {
+        if (total_bytes_ <= target)
+            break;
+        const string &name = victim.second;
+        std::error_code ec;
+        fs::remove(fs::path(dir_) / name.substr(0, 2) / name, ec);
+        total_bytes_ -= entries_[name].size;
+        entries_.erase(name);
+        evicted_++;
+    }
+}
+
+std::string ResultCache::summary() const
+{
+    uint64_t total;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        total = total_bytes_;
+    }
+    char line[200];
+    std::snprintf(line, sizeof(line), "hits=%llu misses=%llu duplicates=%llu evicted=%llu size=%.1f/%.1f MB",
+                  (unsigned long long)hits_.load(), (unsigned long long)misses_.load(),
+                  (unsigned long long)duplicates_.load(), (unsigned long long)evicted_.load(),
+                  total / (1024.0 * 1024.0), max_bytes_ / (1024.0 * 1024.0));
+    return line;
+}
+
+bool CachedResizeImageBuffer(ResultCache *cache, const unsigned char *data, size_t length, const std::string &extension,
+                             const ResizeOptions &options, std::vector<unsigned char> &out_bytes, const std::string &label,
+                             ResizeResult *result)
+{
+    // a copy of the source is cheaper than any cache lookup
+    if (cache == nullptr)
+        return ResizeImageBuffer(data, length, extension, options, out_bytes, label, result);
+    int width = 0, height = 0, channels = 0;
+    if (CanPassThrough(data, length, extension, options, width, height, channels))
+        return ResizeImageBuffer(data, length, extension, options, out_bytes, label, result);
+
+    const string key = cache->key_for(data, length, extension, options);
+    if (!cache->claim(key, extension))
+    {
+        if (cache->fetch(key, extension, out_bytes))
+        {
+            ResizeResult local_result;
+            RecordCacheHit(result != nullptr ? *result : local_result, options, width, height, length, out_bytes.size());
+            return true;
+        }
+        // evicted between claim and fetch, resize it uncached
+        return ResizeImageBuffer(data, length, extension, options, out_bytes, label, result, false);
+    }
+
+    bool ok = false;
+    try
+    {
+        ok = ResizeImageBuffer(data, length, extension, options, out_bytes, label, result, false);
+    }
+    catch (...)
+    {
+        cache->abandon(key, extension);
+        throw;
+    }
+    if (ok)
+        cache->publish(key, extension, out_bytes.data(), out_bytes.size());
+    else
+        cache->abandon(key, extension);
+    return ok;
+}
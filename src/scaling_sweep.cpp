@@ -0,0 +1,193 @@
+#include "scaling_sweep.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "file_helpers.h"
+#include "stats.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// each setting should run at least this long so thread start-up and tail effects stay small
+static const double MIN_SETTING_SECONDS = 2.0;
+
+// a thread count within this fraction of the best throughput counts as "as fast"
+static const double RECOMMEND_TOLERANCE = 0.05;
+
+ThroughputPoint MeasureThroughput(const std::vector<SampleImage> &inputs, const ResizeOptions &options, unsigned int threads, int rounds)
+{
+    const size_t total = inputs.size() * rounds;
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> pixels{0};
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<bool> done{false};
+
+    // RSS is sampled rather than read once at the end, the peak is what a memory limit has to cover
+    ThroughputPoint point;
+    point.threads = threads;
+    point.peak_rss = CurrentRssBytes();
+    std::thread sampler([&done, &point]()
+    {
+        while (!done)
+        {
+            point.peak_rss = std::max(point.peak_rss, CurrentRssBytes());
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            std::vector<unsigned char> output;
+            for (size_t i = next++; i < total; i = next++)
+            {
+                const SampleImage &input = inputs[i % inputs.size()];
+                ResizeResult result;
+                if (ResizeImageBuffer(input.bytes.data(), input.bytes.size(), input.extension, options, output, input.name, &result))
+                {
+                    pixels += (uint64_t)result.input_width * result.input_height;
+                    bytes_out += result.bytes_out;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    point.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    done = true;
+    sampler.join();
+    point.peak_rss = std::max(point.peak_rss, CurrentRssBytes());
+
+    point.images_per_s = total / point.seconds;
+    point.mp_per_s = pixels / 1e6 / point.seconds;
+    point.bytes_out = bytes_out / rounds;
+    return point;
+}
+
+std::vector<SampleImage> LoadSampleImages(const std::string &imgdir, const std::string &imgname, size_t max_files)
+{
+    std::vector<string> files;
+    for (const auto &entry : std::filesystem::directory_iterator(imgdir))
+    {
+        if (!entry.is_regular_file())
+            continue;
+        const string filepath = entry.path().string();
+        if (!imgname.empty() ? entry.path().filename() == imgname : IsSupportedImage(filepath))
+            files.push_back(filepath);
+    }
+    std::sort(files.begin(), files.end());
+    if (files.size() > max_files)
+        files.resize(max_files);
+
+    std::vector<SampleImage> samples;
+    for (const string &file : files)
+    {
+        SampleImage sample;
+        sample.name = file;
+        sample.extension = std::filesystem::path(file).extension().string();
+        if (!ReadFileBytes(file, sample.bytes))
+        {
+            cout << "Skipping unreadable file: " << file << endl;
+            continue;
+        }
+        samples.push_back(std::move(sample));
+    }
+    return samples;
+}
+
+std::vector<unsigned int> SweepThreadCounts()
+{
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> counts;
+    for (unsigned int t = 1; t < cores; t *= 2)
+        counts.push_back(t);
+    counts.push_back(cores);
+    counts.push_back(cores + std::max(1u, cores / 4));
+    counts.push_back(cores * 2);
+    counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+    return counts;
+}
+
+int RoundsForDuration(double single_pass_seconds, double min_seconds)
+{
+    return std::max(1, (int)std::ceil(min_seconds / std::max(single_pass_seconds, 1e-3)));
+}
+
+int RunScalingSweep(const std::string &imgdir, const std::string &imgname, size_t max_files, const ResizeOptions &options)
+{
+    // the sweep measures the CPU side, so inputs are read once up front and outputs are discarded
+    const std::vector<SampleImage> inputs = LoadSampleImages(imgdir, imgname, max_files);
+    if (inputs.empty())
+    {
+        cout << "Error: No supported images found in " << imgdir << endl;
+        return 1;
+    }
+    uint64_t input_bytes = 0;
+    for (const SampleImage &input : inputs)
+        input_bytes += input.bytes.size();
+
+    const unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::vector<unsigned int> counts = SweepThreadCounts();
+
+    cout << "Scaling sweep over " << inputs.size() << " images (" << input_bytes / (1024 * 1024) << " MB) from " << imgdir
+         << ", " << cores << " hardware threads" << endl;
+
+    // the single-threaded warm-up sizes the workload and fills the thread-local caches' code paths
+    const ThroughputPoint warmup = MeasureThroughput(inputs, options, 1, 1);
+    const int rounds = RoundsForDuration(warmup.seconds, MIN_SETTING_SECONDS);
+    cout << "Each setting processes the set " << rounds << " time(s)" << endl << endl;
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%8s %10s %12s %10s %9s %11s %12s", "threads", "seconds", "images/s", "MP/s",
+                  "speedup", "efficiency", "peak RSS MB");
+    cout << line << endl;
+
+    std::vector<ThroughputPoint> points;
+    for (unsigned int threads : counts)
+    {
+        const ThroughputPoint point = MeasureThroughput(inputs, options, threads, rounds);
+        points.push_back(point);
+
+        const double speedup = point.images_per_s / points.front().images_per_s;
+        std::snprintf(line, sizeof(line), "%8u %10.3f %12.1f %10.1f %8.2fx %10.1f%% %12.1f", point.threads, point.seconds,
+                      point.images_per_s, point.mp_per_s, speedup, 100.0 * speedup / point.threads,
+                      point.peak_rss / (1024.0 * 1024.0));
+        cout << line << endl;
+    }
+
+    // fewest threads that get within the tolerance of the best throughput
+    double best = 0;
+    for (const ThroughputPoint &point : points)
+        best = std::max(best, point.images_per_s);
+    const ThroughputPoint *recommended = &points.front();
+    for (const ThroughputPoint &point : points)
+    {
+        if (point.images_per_s >= best * (1.0 - RECOMMEND_TOLERANCE))
+        {
+            recommended = &point;
+            break;
+        }
+    }
+
+    // what a plain run would pick: every core, minus two on machines with more than 7
+    const unsigned int default_threads = cores > 7 ? cores - 2 : cores;
+    cout << endl << "Recommended: --threads " << recommended->threads << " (" << (int)recommended->images_per_s
+         << " images/s, within " << (int)(RECOMMEND_TOLERANCE * 100) << "% of the best measured)" << endl;
+    cout << "The default for this machine is " << default_threads << " threads";
+    if (recommended->threads > cores)
+        cout << ", this workload gains from oversubscription which --threads currently caps at " << cores;
+    cout << "." << endl;
+    return 0;
+}
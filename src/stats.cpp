@@ -0,0 +1,303 @@
+#include "stats.h"
+#include "alloc_tracker.h"
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+const char *StageName(Stage stage)
+{
+    switch (stage)
+    {
+    case STAGE_READ:
+        return "read";
+    case STAGE_DECODE:
+        return "decode";
+    case STAGE_RESIZE:
+        return "resize";
+    case STAGE_ENCODE:
+        return "encode";
+    case STAGE_WRITE:
+        return "write";
+    default:
+        return "?";
+    }
+}
+
+static int bucket_index(uint64_t ns)
+{
+    const int sub_buckets = 1 << LatencyHistogram::SUB_BUCKET_BITS;
+    if (ns < (uint64_t)sub_buckets)
+        return (int)ns;
+
+    const int msb = 63 - __builtin_clzll(ns);
+    const int sub = (int)((ns >> (msb - LatencyHistogram::SUB_BUCKET_BITS)) & (sub_buckets - 1));
+    return msb * sub_buckets + sub;
+}
+
+// midpoint of the values that land in a bucket
+static uint64_t bucket_value(int index)
+{
+    const int sub_buckets = 1 << LatencyHistogram::SUB_BUCKET_BITS;
+    if (index < sub_buckets)
+        return (uint64_t)index;
+
+    const int msb = index / sub_buckets;
+    const int sub = index % sub_buckets;
+    const int shift = msb - LatencyHistogram::SUB_BUCKET_BITS;
+    const uint64_t lower = ((uint64_t)(sub_buckets | sub)) << shift;
+    return lower + ((1ULL << shift) >> 1);
+}
+
+void LatencyHistogram::add(uint64_t ns)
+{
+    buckets_[bucket_index(ns)]++;
+    count_++;
+    total_ns_ += ns;
+    if (ns > max_ns_)
+        max_ns_ = ns;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (int i = 0; i < BUCKETS; ++i)
+        buckets_[i] += other.buckets_[i];
+    count_ += other.count_;
+    total_ns_ += other.total_ns_;
+    if (other.max_ns_ > max_ns_)
+        max_ns_ = other.max_ns_;
+}
+
+uint64_t LatencyHistogram::percentile(double q) const
+{
+    if (count_ == 0)
+        return 0;
+
+    const uint64_t rank = (uint64_t)(q * (double)(count_ - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i)
+    {
+        seen += buckets_[i];
+        if (seen >= rank)
+            return bucket_value(i) < max_ns_ ? bucket_value(i) : max_ns_;
+    }
+    return max_ns_;
+}
+
+void PipelineStats::merge(const PipelineStats &other)
+{
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        stages[i].merge(other.stages[i]);
+    bytes_in += other.bytes_in;
+    bytes_out += other.bytes_out;
+    pixels_in += other.pixels_in;
+    pixels_out += other.pixels_out;
+    images += other.images;
+    failures += other.failures;
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        skipped[i] += other.skipped[i];
+    passthrough += other.passthrough;
+    upscale_avoided += other.upscale_avoided;
+    kept_source += other.kept_source;
+    gray_collapsed += other.gray_collapsed;
+    alpha_dropped += other.alpha_dropped;
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c)
+            perf[i][c] += other.perf[i][c];
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        if (other.stage_peak_bytes[i] > stage_peak_bytes[i])
+            stage_peak_bytes[i] = other.stage_peak_bytes[i];
+    if (other.image_peak_bytes > image_peak_bytes)
+    {
+        image_peak_bytes = other.image_peak_bytes;
+        image_peak_width = other.image_peak_width;
+        image_peak_height = other.image_peak_height;
+    }
+}
+
+void PipelineStats::record_peak_memory(const uint64_t peak_bytes[STAGE_COUNT], int width, int height)
+{
+    uint64_t image_peak = 0;
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        if (peak_bytes[i] > stage_peak_bytes[i])
+            stage_peak_bytes[i] = peak_bytes[i];
+        if (peak_bytes[i] > image_peak)
+            image_peak = peak_bytes[i];
+    }
+    if (image_peak > image_peak_bytes)
+    {
+        image_peak_bytes = image_peak;
+        image_peak_width = width;
+        image_peak_height = height;
+    }
+}
+
+// Counters outlive their threads so short-lived workers still show up in the summary
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<PipelineStats>> registry;
+
+PipelineStats &LocalStats()
+{
+    static thread_local PipelineStats *local = nullptr;
+    if (local == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(std::make_unique<PipelineStats>());
+        local = registry.back().get();
+    }
+    return *local;
+}
+
+PipelineStats CollectStats()
+{
+    PipelineStats total;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto &stats : registry)
+        total.merge(*stats);
+    return total;
+}
+
+uint64_t CurrentRssBytes()
+{
+#ifdef __linux__
+    // second field of statm is resident pages, cheaper than parsing /proc/self/status
+    FILE *file = std::fopen("/proc/self/statm", "r");
+    if (file == nullptr)
+        return 0;
+    unsigned long long size = 0, resident = 0;
+    const int fields = std::fscanf(file, "%llu %llu", &size, &resident);
+    std::fclose(file);
+    return fields == 2 ? resident * (uint64_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+void PrintStatsSummary(const PipelineStats &stats, double elapsed_seconds)
+{
+    const double mb = 1024.0 * 1024.0;
+    char line[256];
+
+    cout << "--- Stats ---" << endl;
+    std::snprintf(line, sizeof(line), "images:  %llu ok, %llu failed, %.1f images/s",
+                  (unsigned long long)stats.images, (unsigned long long)stats.failures,
+                  elapsed_seconds > 0 ? stats.images / elapsed_seconds : 0.0);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "bytes:   in %.2f MB, out %.2f MB (out/in %.3f)",
+                  stats.bytes_in / mb, stats.bytes_out / mb,
+                  stats.bytes_in ? (double)stats.bytes_out / stats.bytes_in : 0.0);
+    cout << line << endl;
+    std::snprintf(line, sizeof(line), "pixels:  in %.2f MP, out %.2f MP",
+                  stats.pixels_in / 1e6, stats.pixels_out / 1e6);
+    cout << line << endl;
+    if (stats.skipped[STAGE_DECODE] + stats.skipped[STAGE_RESIZE] + stats.skipped[STAGE_ENCODE] > 0)
+    {
+        std::snprintf(line, sizeof(line), "skipped: decode %llu, resize %llu, encode %llu (%llu passed through unchanged)",
+                      (unsigned long long)stats.skipped[STAGE_DECODE], (unsigned long long)stats.skipped[STAGE_RESIZE],
+                      (unsigned long long)stats.skipped[STAGE_ENCODE], (unsigned long long)stats.passthrough);
+        cout << line << endl;
+    }
+    if (stats.upscale_avoided + stats.kept_source + stats.gray_collapsed + stats.alpha_dropped > 0)
+    {
+        std::snprintf(line, sizeof(line), "policy:  %llu upscales avoided, %llu sources kept as smaller than the encode, %llu processed as gray, %llu opaque alpha dropped",
+                      (unsigned long long)stats.upscale_avoided, (unsigned long long)stats.kept_source,
+                      (unsigned long long)stats.gray_collapsed, (unsigned long long)stats.alpha_dropped);
+        cout << line << endl;
+    }
+    std::snprintf(line, sizeof(line), "memory:  stb heap peak per image: decode %.1f MB, resize %.1f MB, encode %.1f MB",
+                  stats.stage_peak_bytes[STAGE_DECODE] / mb, stats.stage_peak_bytes[STAGE_RESIZE] / mb,
+                  stats.stage_peak_bytes[STAGE_ENCODE] / mb);
+    cout << line << endl;
+    if (stats.image_peak_bytes > 0)
+    {
+        const double pixels = (double)stats.image_peak_width * stats.image_peak_height;
+        std::snprintf(line, sizeof(line), "         largest %.1f MB for %dx%d (%.1f bytes/pixel), process RSS high-water %.1f MB",
+                      stats.image_peak_bytes / mb, stats.image_peak_width, stats.image_peak_height,
+                      pixels > 0 ? stats.image_peak_bytes / pixels : 0.0, PeakRssBytes() / mb);
+        cout << line << endl;
+    }
+
+    // throughput is per thread-second spent in the stage, i.e. what one core achieves
+    std::snprintf(line, sizeof(line), "%-8s %10s %7s %14s %9s %9s %9s %9s",
+                  "stage", "cpu s", "share", "throughput", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    cout << line << endl;
+
+    uint64_t all_stage_ns = 0;
+    for (int i = 0; i < STAGE_COUNT; ++i)
+        all_stage_ns += stats.stages[i].total_ns();
+
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        const LatencyHistogram &h = stats.stages[i];
+        const double seconds = h.total_ns() / 1e9;
+
+        char throughput[32] = "-";
+        if (seconds > 0)
+        {
+            switch (i)
+            {
+            case STAGE_READ:
+                std::snprintf(throughput, sizeof(throughput), "%.1f MB/s", stats.bytes_in / mb / seconds);
+                break;
+            case STAGE_WRITE:
+                std::snprintf(throughput, sizeof(throughput), "%.1f MB/s", stats.bytes_out / mb / seconds);
+                break;
+            case STAGE_DECODE:
+            case STAGE_RESIZE:
+                std::snprintf(throughput, sizeof(throughput), "%.1f MP/s", stats.pixels_in / 1e6 / seconds);
+                break;
+            case STAGE_ENCODE:
+                std::snprintf(throughput, sizeof(throughput), "%.1f MP/s", stats.pixels_out / 1e6 / seconds);
+                break;
+            }
+        }
+
+        std::snprintf(line, sizeof(line), "%-8s %10.3f %6.1f%% %14s %9.3f %9.3f %9.3f %9.3f",
+                      StageName((Stage)i), seconds,
+                      all_stage_ns ? 100.0 * h.total_ns() / all_stage_ns : 0.0, throughput,
+                      h.percentile(0.50) / 1e6, h.percentile(0.90) / 1e6, h.percentile(0.99) / 1e6, h.max_ns() / 1e6);
+        cout << line << endl;
+    }
+
+    if (!PerfCountersEnabled())
+        return;
+
+    // misses are normalised by the pixels the stage works on, the same split as the throughput column
+    std::snprintf(line, sizeof(line), "%-8s %12s %12s %7s %14s %14s", "stage", "Gcycles", "Ginstr", "IPC",
+                  "LLC miss/MP", "br miss/MP");
+    cout << line << endl;
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        const uint64_t *counters = stats.perf[i];
+        const double megapixels = (i == STAGE_ENCODE || i == STAGE_WRITE ? stats.pixels_out : stats.pixels_in) / 1e6;
+
+        auto per_mp = [&](char *text, size_t size, PerfCounter counter)
+        {
+            if (!PerfCounterAvailable(counter) || megapixels <= 0)
+                std::snprintf(text, size, "-");
+            else
+                std::snprintf(text, size, "%.0f", counters[counter] / megapixels);
+        };
+        char instructions[32] = "-", ipc[32] = "-", llc[32], branch[32];
+        if (PerfCounterAvailable(PERF_INSTRUCTIONS))
+        {
+            std::snprintf(instructions, sizeof(instructions), "%.3f", counters[PERF_INSTRUCTIONS] / 1e9);
+            if (counters[PERF_CYCLES] > 0)
+                std::snprintf(ipc, sizeof(ipc), "%.2f", (double)counters[PERF_INSTRUCTIONS] / counters[PERF_CYCLES]);
+        }
+        per_mp(llc, sizeof(llc), PERF_LLC_MISSES);
+        per_mp(branch, sizeof(branch), PERF_BRANCH_MISSES);
+
+        std::snprintf(line, sizeof(line), "%-8s %12.3f %12s %7s %14s %14s", StageName((Stage)i),
+                      counters[PERF_CYCLES] / 1e9, instructions, ipc, llc, branch);
+        cout << line << endl;
+    }
+}
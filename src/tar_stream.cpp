@@ -0,0 +1,329 @@
+#include "tar_stream.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+static const size_t TAR_BLOCK = 512;
+
+// large stdio buffers so a tar stream is read/written in big sequential chunks
+static const size_t TAR_STREAM_BUFFER = 1 << 20;
+
+// Numeric header fields are NUL/space terminated octal, or base-256 when the high bit is set
+static unsigned long long parse_tar_number(const unsigned char *field, size_t length)
+{
+    unsigned long long value = 0;
+    if (field[0] & 0x80)
+    {
+        value = field[0] & 0x7f;
+        for (size_t i = 1; i < length; ++i)
+            value = (value << 8) | field[i];
+        return value;
+    }
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (field[i] == ' ' || field[i] == '\0')
+        {
+            if (value != 0)
+                break;
+            continue;
+        }
+        if (field[i] < '0' || field[i] > '7')
+            break;
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+static void write_tar_number(char *field, size_t length, unsigned long long value)
+{
+    // octal fits in length - 1 digits plus a NUL, otherwise fall back to base-256
+    if (value < (1ULL << (3 * (length - 1))))
+    {
+        std::snprintf(field, length, "%0*llo", (int)(length - 1), value);
+        return;
+    }
+
+    std::memset(field, 0, length);
+    for (size_t i = length - 1; i > 0; --i)
+    {
+        field[i] = (char)(value & 0xff);
+        value >>= 8;
+    }
+    field[0] = (char)0x80;
+}
+
+static unsigned int header_checksum(const unsigned char *block)
+{
+    unsigned int sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK; ++i)
+        sum += (i >= 148 && i < 156) ? ' ' : block[i];
+    return sum;
+}
+
+static std::string header_string(const unsigned char *field, size_t length)
+{
+    return std::string(reinterpret_cast<const char *>(field), strnlen(reinterpret_cast<const char *>(field), length));
+}
+
+static size_t padding_for(size_t size)
+{
+    return (TAR_BLOCK - size % TAR_BLOCK) % TAR_BLOCK;
+}
+
+// pax extended headers are a list of "<len> key=value\n" records, we only care about path
+static std::string pax_path(const std::vector<unsigned char> &data)
+{
+    std::string path;
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t space = pos;
+        while (space < data.size() && data[space] != ' ')
+            ++space;
+        size_t record_length = std::strtoul(std::string(data.begin() + pos, data.begin() + space).c_str(), nullptr, 10);
+        if (record_length == 0 || pos + record_length > data.size())
+            break;
+
+        std::string record(data.begin() + space + 1, data.begin() + pos + record_length - 1);
+        if (record.rfind("path=", 0) == 0)
+            path = record.substr(5);
+        pos += record_length;
+    }
+    return path;
+}
+
+std::string SafeMemberPath(const std::string &name)
+{
+    std::string safe;
+    size_t pos = 0;
+    while (pos <= name.size())
+    {
+        size_t slash = name.find('/', pos);
+        if (slash == std::string::npos)
+            slash = name.size();
+
+        std::string part = name.substr(pos, slash - pos);
+        pos = slash + 1;
+        if (part.empty() || part == ".")
+            continue;
+        if (part == "..")
+            return "";
+
+        safe += safe.empty() ? part : "/" + part;
+    }
+    return safe;
+}
+
+TarReader::TarReader(const std::string &path)
+{
+    if (path == "-")
+        file_ = stdin;
+    else
+    {
+        file_ = std::fopen(path.c_str(), "rb");
+        owns_file_ = true;
+    }
+
+    if (file_ != nullptr)
+        std::setvbuf(file_, nullptr, _IOFBF, TAR_STREAM_BUFFER);
+}
+
+TarReader::~TarReader()
+{
+    if (file_ != nullptr && owns_file_)
+        std::fclose(file_);
+}
+
+bool TarReader::read_block(unsigned char *block)
+{
+    return std::fread(block, 1, TAR_BLOCK, file_) == TAR_BLOCK;
+}
+
+bool TarReader::read_payload(size_t size, std::vector<unsigned char> &data)
+{
+    data.resize(size);
+    if (size != 0 && std::fread(data.data(), 1, size, file_) != size)
+        return false;
+    return skip_payload(padding_for(size));
+}
+
+bool TarReader::skip_payload(size_t size)
+{
+    unsigned char discard[TAR_BLOCK];
+    while (size > 0)
+    {
+        size_t chunk = size < TAR_BLOCK ? size : TAR_BLOCK;
+        if (std::fread(discard, 1, chunk, file_) != chunk)
+            return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool TarReader::next(TarMember &member)
+{
+    if (file_ == nullptr)
+        return false;
+
+    std::string long_name;
+    unsigned char block[TAR_BLOCK];
+
+    while (true)
+    {
+        if (!read_block(block))
+        {
+            if (!std::feof(file_) || std::ferror(file_))
+                error_ = "read error";
+            return false; // a truncated archive without end marker is treated as the end
+        }
+
+        // a zero block marks the end of the archive
+        bool all_zero = true;
+        for (size_t i = 0; i < TAR_BLOCK && all_zero; ++i)
+            all_zero = block[i] == 0;
+        if (all_zero)
+            return false;
+
+        if (parse_tar_number(block + 148, 8) != header_checksum(block))
+        {
+            error_ = "bad header checksum";
+            return false;
+        }
+
+        const size_t size = (size_t)parse_tar_number(block + 124, 12);
+        const char type = (char)block[156];
+
+        if (type == 'L' || type == 'x')
+        {
+            std::vector<unsigned char> payload;
+            if (!read_payload(size, payload))
+            {
+                error_ = "truncated archive";
+                return false;
+            }
+            long_name = type == 'L' ? header_string(payload.data(), payload.size()) : pax_path(payload);
+            continue;
+        }
+
+        if (type != '0' && type != '\0' && type != '7')
+        {
+            // directories, links, global pax headers ...
+            if (!skip_payload(size + padding_for(size)))
+            {
+                error_ = "truncated archive";
+                return false;
+            }
+            long_name.clear();
+            continue;
+        }
+
+        if (!long_name.empty())
+            member.name = long_name;
+        else
+        {
+            std::string name = header_string(block, 100);
+            std::string prefix = header_string(block + 345, 155);
+            bool ustar = std::memcmp(block + 257, "ustar", 5) == 0;
+            member.name = (ustar && !prefix.empty()) ? prefix + "/" + name : name;
+        }
+
+        if (!read_payload(size, member.data))
+        {
+            error_ = "truncated archive";
+            return false;
+        }
+        return true;
+    }
+}
+
+TarWriter::TarWriter(const std::string &path)
+{
+    if (path == "-")
+        file_ = stdout;
+    else
+    {
+        file_ = std::fopen(path.c_str(), "wb");
+        owns_file_ = true;
+    }
+
+    if (file_ != nullptr)
+        std::setvbuf(file_, nullptr, _IOFBF, TAR_STREAM_BUFFER);
+}
+
+TarWriter::~TarWriter()
+{
+    finish();
+    if (file_ != nullptr && owns_file_)
+        std::fclose(file_);
+}
+
+bool TarWriter::write_padded(const unsigned char *data, size_t length)
+{
+    static const unsigned char zeros[TAR_BLOCK] = {};
+    if (length != 0 && std::fwrite(data, 1, length, file_) != length)
+        return false;
+
+    size_t padding = padding_for(length);
+    return padding == 0 || std::fwrite(zeros, 1, padding, file_) == padding;
+}
+
+bool TarWriter::write_header(const std::string &name, size_t length, char type)
+{
+    char block[TAR_BLOCK] = {};
+
+    // ustar can split a path of up to 255 chars into prefix/name at a '/'
+    std::string stored_name = name;
+    std::string prefix;
+    if (name.size() > 100)
+    {
+        size_t split = name.rfind('/', 155);
+        if (split != std::string::npos && name.size() - split - 1 <= 100 && split <= 155)
+        {
+            prefix = name.substr(0, split);
+            stored_name = name.substr(split + 1);
+        }
+        else
+        {
+            // GNU long name entry, the real header follows with a truncated name
+            if (!write_header("././@LongLink", name.size() + 1, 'L') ||
+                !write_padded(reinterpret_cast<const unsigned char *>(name.c_str()), name.size() + 1))
+                return false;
+            stored_name = name.substr(0, 100);
+        }
+    }
+
+    std::memcpy(block, stored_name.data(), stored_name.size() < 100 ? stored_name.size() : 100);
+    write_tar_number(block + 100, 8, 0644);
+    write_tar_number(block + 108, 8, 0);
+    write_tar_number(block + 116, 8, 0);
+    write_tar_number(block + 124, 12, length);
+    write_tar_number(block + 136, 12, (unsigned long long)std::time(nullptr));
+    block[156] = type;
+    std::memcpy(block + 257, "ustar", 6);
+    std::memcpy(block + 263, "00", 2);
+    std::memcpy(block + 345, prefix.data(), prefix.size());
+
+    std::snprintf(block + 148, 8, "%06o", header_checksum(reinterpret_cast<unsigned char *>(block)));
+    block[155] = ' ';
+
+    return std::fwrite(block, 1, TAR_BLOCK, file_) == TAR_BLOCK;
+}
+
+bool TarWriter::append(const std::string &name, const unsigned char *data, size_t length)
+{
+    if (file_ == nullptr || finished_)
+        return false;
+    return write_header(name, length, '0') && write_padded(data, length);
+}
+
+bool TarWriter::finish()
+{
+    if (file_ == nullptr || finished_)
+        return false;
+    finished_ = true;
+
+    static const unsigned char zeros[TAR_BLOCK * 2] = {};
+    bool ok = std::fwrite(zeros, 1, sizeof(zeros), file_) == sizeof(zeros);
+    return std::fflush(file_) == 0 && ok;
+}
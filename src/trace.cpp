@@ -0,0 +1,164 @@
+#include "trace.h"
+#include "stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+bool g_trace_enabled = false;
+
+static const size_t TRACE_RING_EVENTS = 1 << 16; // 4 MB per thread
+static const size_t TRACE_LABEL_SIZE = 40;
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    char label[TRACE_LABEL_SIZE];
+};
+static_assert(sizeof(TraceEvent) == 64, "one cache line per span");
+
+struct TraceRing
+{
+    std::vector<TraceEvent> events = std::vector<TraceEvent>(TRACE_RING_EVENTS);
+    uint64_t written = 0;
+    uint32_t tid = 0;
+    std::string thread_name;
+    char current_label[TRACE_LABEL_SIZE] = {};
+};
+
+static std::mutex trace_mutex;
+static std::vector<std::unique_ptr<TraceRing>> trace_rings;
+static uint64_t trace_start_ns = 0;
+
+static TraceRing &local_ring()
+{
+    static thread_local TraceRing *ring = nullptr;
+    if (ring == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        trace_rings.push_back(std::make_unique<TraceRing>());
+        ring = trace_rings.back().get();
+        ring->tid = (uint32_t)trace_rings.size();
+    }
+    return *ring;
+}
+
+// keeps the tail of long paths, that's the part that identifies the file
+static void copy_label(char *dest, const std::string &label)
+{
+    const size_t keep = std::min(label.size(), TRACE_LABEL_SIZE - 1);
+    std::memcpy(dest, label.data() + label.size() - keep, keep);
+    dest[keep] = '\0';
+}
+
+void TraceEnable()
+{
+    g_trace_enabled = true;
+    trace_start_ns = StatsNowNs();
+}
+
+void TraceSetThreadName(const char *name)
+{
+    if (!g_trace_enabled)
+        return;
+    local_ring().thread_name = name;
+}
+
+void TraceRecord(const char *name, uint64_t start_ns, uint64_t duration_ns)
+{
+    if (!g_trace_enabled)
+        return;
+
+    TraceRing &ring = local_ring();
+    TraceEvent &event = ring.events[ring.written % TRACE_RING_EVENTS];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    std::memcpy(event.label, ring.current_label, TRACE_LABEL_SIZE);
+    ring.written++;
+}
+
+TraceScope::TraceScope(const char *name, const std::string &label) : name_(name)
+{
+    if (!g_trace_enabled)
+        return;
+
+    if (!label.empty())
+    {
+        copy_label(local_ring().current_label, label);
+        labelled_ = true;
+    }
+    start_ = StatsNowNs();
+}
+
+TraceScope::~TraceScope()
+{
+    if (!g_trace_enabled)
+        return;
+
+    TraceRecord(name_, start_, StatsNowNs() - start_);
+    if (labelled_)
+        local_ring().current_label[0] = '\0';
+}
+
+static void write_json_string(FILE *file, const char *text)
+{
+    std::fputc('"', file);
+    for (const char *c = text; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            std::fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20)
+            std::fprintf(file, "\\u%04x", (unsigned char)*c);
+        else
+            std::fputc(*c, file);
+    }
+    std::fputc('"', file);
+}
+
+bool TraceWrite(const std::string &path)
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+
+    for (const auto &ring : trace_rings)
+    {
+        if (!ring->thread_name.empty())
+        {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", ring->tid);
+            write_json_string(file, (ring->thread_name + " " + std::to_string(ring->tid)).c_str());
+            std::fprintf(file, "}}");
+            first = false;
+        }
+
+        const uint64_t count = std::min<uint64_t>(ring->written, TRACE_RING_EVENTS);
+        for (uint64_t i = ring->written - count; i < ring->written; ++i)
+        {
+            const TraceEvent &event = ring->events[i % TRACE_RING_EVENTS];
+            const uint64_t start = event.start_ns > trace_start_ns ? event.start_ns - trace_start_ns : 0;
+
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                         first ? "" : ",\n", event.name, ring->tid, start / 1000.0, event.duration_ns / 1000.0);
+            if (event.label[0] != '\0')
+            {
+                std::fprintf(file, ",\"args\":{\"file\":");
+                write_json_string(file, event.label);
+                std::fprintf(file, "}");
+            }
+            std::fprintf(file, "}");
+            first = false;
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,126 @@
+#include "tuning_profile.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+std::string HostName()
+{
+#ifdef _WIN32
+    char name[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD size = sizeof(name);
+    if (GetComputerNameA(name, &size))
+        return std::string(name, size);
+#else
+    char name[256];
+    if (gethostname(name, sizeof(name)) == 0)
+    {
+        name[sizeof(name) - 1] = '\0';
+        return name;
+    }
+#endif
+    return "localhost";
+}
+
+std::string DefaultTuningProfilePath()
+{
+    std::filesystem::path dir;
+#ifdef _WIN32
+    if (const char *appdata = std::getenv("APPDATA"))
+        dir = appdata;
+#else
+    if (const char *config = std::getenv("XDG_CONFIG_HOME"); config && *config)
+        dir = config;
+    else if (const char *home = std::getenv("HOME"))
+        dir = std::filesystem::path(home) / ".config";
+#endif
+    if (dir.empty())
+        dir = ".";
+    return (dir / "imagecompress" / ("tune-" + HostName() + ".conf")).string();
+}
+
+bool LoadTuningProfile(const std::string &path, TuningProfile &profile)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == std::string::npos)
+            continue;
+        const std::string key = line.substr(0, equals);
+        const std::string value = line.substr(equals + 1);
+        try
+        {
+            if (key == "host")
+                profile.host = value;
+            else if (key == "cores")
+                profile.cores = (unsigned int)std::stoul(value);
+            else if (key == "threads")
+                profile.threads = (unsigned int)std::stoul(value);
+            else if (key == "png_level")
+                profile.png_level = std::stoi(value);
+            else if (key == "png_filter")
+                profile.png_filter = std::stoi(value);
+            else if (key == "images_per_s")
+                profile.images_per_s = std::stod(value);
+            else if (key == "model_decode_jpeg_mps")
+                profile.model.decode_jpeg_mps = std::stod(value);
+            else if (key == "model_decode_png_mps")
+                profile.model.decode_png_mps = std::stod(value);
+            else if (key == "model_resize_mps")
+                profile.model.resize_mps = std::stod(value);
+            else if (key == "model_encode_jpeg_mps")
+                profile.model.encode_jpeg_mps = std::stod(value);
+            else if (key == "model_encode_png_mps")
+                profile.model.encode_png_mps = std::stod(value);
+            else if (key == "model_jpeg_bytes_per_pixel")
+                profile.model.jpeg_bytes_per_pixel = std::stod(value);
+            else if (key == "model_png_bytes_per_pixel")
+                profile.model.png_bytes_per_pixel = std::stod(value);
+            else if (key == "model_jpeg_quality")
+                profile.model.jpeg_quality = std::stoi(value);
+            else if (key == "model_peak_bytes_per_pixel")
+                profile.model.peak_bytes_per_pixel = std::stod(value);
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SaveTuningProfile(const std::string &path, const TuningProfile &profile)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    std::ofstream file(path);
+    if (!file)
+        return false;
+    file << "# ImageCompress tuning profile, written by --autotune\n"
+         << "host=" << profile.host << "\n"
+         << "cores=" << profile.cores << "\n"
+         << "threads=" << profile.threads << "\n"
+         << "png_level=" << profile.png_level << "\n"
+         << "png_filter=" << profile.png_filter << "\n"
+         << "images_per_s=" << profile.images_per_s << "\n"
+         << "model_decode_jpeg_mps=" << profile.model.decode_jpeg_mps << "\n"
+         << "model_decode_png_mps=" << profile.model.decode_png_mps << "\n"
+         << "model_resize_mps=" << profile.model.resize_mps << "\n"
+         << "model_encode_jpeg_mps=" << profile.model.encode_jpeg_mps << "\n"
+         << "model_encode_png_mps=" << profile.model.encode_png_mps << "\n"
+         << "model_jpeg_bytes_per_pixel=" << profile.model.jpeg_bytes_per_pixel << "\n"
+         << "model_png_bytes_per_pixel=" << profile.model.png_bytes_per_pixel << "\n"
+         << "model_jpeg_quality=" << profile.model.jpeg_quality << "\n"
+         << "model_peak_bytes_per_pixel=" << profile.model.peak_bytes_per_pixel << "\n";
+    return (bool)file.flush();
+}
@@ -0,0 +1,262 @@
+#include "watch_mode.h"
+#include <iostream>
+
+#ifndef __linux__
+
+int RunWatchMode(const std::string &imgdir, const std::string &outdir, bool recursive, int debounce_ms,
+                 unsigned int threads, const ResizeOptions &options)
+{
+    std::cout << "Error: --watch uses inotify and is only supported on Linux." << std::endl;
+    return 1;
+}
+
+#else
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "blocking_queue.h"
+#include "file_helpers.h"
+#include "latency_recorder.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using Clock = std::chrono::steady_clock;
+
+static volatile std::sig_atomic_t watch_stop_requested = 0;
+
+static void handle_watch_stop_signal(int)
+{
+    watch_stop_requested = 1;
+}
+
+struct WatchJob
+{
+    string path;
+    Clock::time_point enqueued;
+};
+
+static bool is_inside(const std::filesystem::path &path, const std::filesystem::path &dir)
+{
+    auto mismatch = std::mismatch(dir.begin(), dir.end(), path.begin(), path.end());
+    return mismatch.first == dir.end();
+}
+
+int RunWatchMode(const std::string &imgdir,
+                 const std::string &outdir,
+                 bool recursive,
+                 int debounce_ms,
+                 unsigned int threads,
+                 const ResizeOptions &options)
+{
+    if (threads == 0)
+        threads = 1;
+
+    const std::filesystem::path root = std::filesystem::weakly_canonical(imgdir);
+    const std::filesystem::path output_root = std::filesystem::weakly_canonical(outdir);
+    if (root == output_root)
+    {
+        cout << "Error: --watch needs an --outdir different from --imgdir, otherwise results would be picked up again." << endl;
+        return 1;
+    }
+
+    int inotify_fd = ::inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd < 0)
+    {
+        cout << "Error: inotify_init1 failed: " << std::strerror(errno) << endl;
+        return 1;
+    }
+
+    const uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | (recursive ? IN_CREATE : 0);
+    std::unordered_map<int, std::filesystem::path> watched_dirs;
+
+    auto add_watch = [&](const std::filesystem::path &dir)
+    {
+        // results written below the watched tree must never feed back into the queue
+        if (is_inside(dir, output_root))
+            return;
+        int wd = ::inotify_add_watch(inotify_fd, dir.c_str(), watch_mask);
+        if (wd < 0)
+        {
+            cout << "Warning: cannot watch " << dir.string() << ": " << std::strerror(errno) << endl;
+            return;
+        }
+        watched_dirs[wd] = dir;
+    };
+
+    add_watch(root);
+    if (recursive)
+    {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (it->is_directory())
+                add_watch(it->path());
+        }
+    }
+
+    std::signal(SIGINT, handle_watch_stop_signal);
+    std::signal(SIGTERM, handle_watch_stop_signal);
+
+    BlockingQueue<WatchJob> jobs(threads * 64);
+    LatencyRecorder latency;
+    std::atomic<unsigned long long> processed{0};
+
+    // Warm worker pool for the lifetime of the watch
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&]()
+        {
+            WatchJob job;
+            while (jobs.pop(job))
+            {
+                // mirror sub folders of a recursive watch under outdir
+                std::filesystem::path target_dir = output_root;
+                const std::filesystem::path parent = std::filesystem::path(job.path).parent_path();
+                if (parent != root)
+                    target_dir /= std::filesystem::relative(parent, root);
+
+                std::error_code ec;
+                std::filesystem::create_directories(target_dir, ec);
+                ResizeImage(job.path, target_dir.string(), options);
+
+                latency.record(std::chrono::duration<double, std::milli>(Clock::now() - job.enqueued).count());
+                processed++;
+            }
+        });
+    }
+
+    cout << "Watching " << root.string() << (recursive ? " (recursive)" : "") << " -> " << output_root.string()
+         << " with " << threads << " threads, debounce " << debounce_ms << " ms (Ctrl+C to stop)" << endl;
+
+    // path -> time after which it is considered settled and gets enqueued
+    std::map<string, Clock::time_point> pending;
+    const auto debounce = std::chrono::milliseconds(debounce_ms);
+    auto last_report = Clock::now();
+    unsigned long long last_reported = 0;
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    // Queues the images in dir. With deep, sub folders are watched and scanned too: a folder
+    // created or moved into a recursive watch already holds files nobody will get events for.
+    auto scan_dir = [&](const std::filesystem::path &dir, bool deep)
+    {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(dir, ec); it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (is_inside(it->path(), output_root))
+            {
+                it.disable_recursion_pending();
+                continue;
+            }
+            if (it->is_directory(ec))
+            {
+                if (deep)
+                    add_watch(it->path());
+                else
+                    it.disable_recursion_pending();
+            }
+            else if (IsSupportedImage(it->path().string()))
+                pending[it->path().string()] = Clock::now() + debounce;
+        }
+    };
+
+    while (!watch_stop_requested)
+    {
+        int timeout_ms = 1000;
+        if (!pending.empty())
+        {
+            auto next = std::min_element(pending.begin(), pending.end(),
+                                         [](const auto &a, const auto &b) { return a.second < b.second; })->second;
+            timeout_ms = (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count() + 1);
+        }
+
+        pollfd waiting = {inotify_fd, POLLIN, 0};
+        if (::poll(&waiting, 1, timeout_ms) > 0)
+        {
+            ssize_t length;
+            while ((length = ::read(inotify_fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char *ptr = buffer; ptr < buffer + length;)
+                {
+                    const inotify_event *event = reinterpret_cast<const inotify_event *>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW)
+                    {
+                        // events were dropped, so every watched folder is looked at again
+                        cout << "Warning: inotify queue overflowed, rescanning the watched folders" << endl;
+                        std::vector<std::filesystem::path> dirs;
+                        for (const auto &watched : watched_dirs)
+                            dirs.push_back(watched.second);
+                        for (const std::filesystem::path &dir : dirs)
+                            scan_dir(dir, recursive);
+                        continue;
+                    }
+
+                    auto dir = watched_dirs.find(event->wd);
+                    if (dir == watched_dirs.end() || event->len == 0)
+                        continue;
+                    const std::filesystem::path path = dir->second / event->name;
+
+                    if (event->mask & IN_ISDIR)
+                    {
+                        if (recursive && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                        {
+                            add_watch(path);
+                            scan_dir(path, true);
+                        }
+                        continue;
+                    }
+                    if (event->mask & IN_IGNORED)
+                        continue;
+                    if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && IsSupportedImage(path.string()))
+                        pending[path.string()] = Clock::now() + debounce; // a later event pushes the deadline out
+                }
+            }
+        }
+
+        const auto now = Clock::now();
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if (it->second <= now)
+            {
+                jobs.push(WatchJob{it->first, now});
+                it = pending.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        // periodic SLO line while files are flowing
+        if (now - last_report >= std::chrono::seconds(10) && processed != last_reported)
+        {
+            last_reported = processed;
+            last_report = now;
+            cout << "Processed " << last_reported << " files, enqueue-to-written " << latency.format() << endl;
+        }
+    }
+
+    cout << "Stopping watch, finishing queued files ..." << endl;
+    jobs.close();
+    for (std::thread &worker : workers)
+        worker.join();
+    ::close(inotify_fd);
+
+    cout << "Processed " << processed.load() << " files, enqueue-to-written " << latency.format() << endl;
+    return 0;
+}
+
+#endif